@@ -0,0 +1,151 @@
+#include "bufferPool.h"
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <iostream>
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace Spinnaker::GenICam;
+using namespace std;
+
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+static size_t RoundUp(size_t value, size_t multiple)
+{
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+BufferPool::BufferPool()
+    : m_base(nullptr),
+      m_mapSize(0),
+      m_bufferSize(0),
+      m_hugePages(false)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    Free();
+}
+
+int BufferPool::Allocate(size_t count, size_t bufferSize, bool hugePages)
+{
+    Free();
+
+    // every buffer starts on a page boundary, which also satisfies the USB3
+    // 1024 byte packet alignment
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t stride = RoundUp(bufferSize, pageSize);
+    m_mapSize = stride * count;
+
+    m_base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (hugePages)
+    {
+        const size_t hugeSize = RoundUp(m_mapSize, HUGE_PAGE_SIZE);
+        m_base = mmap(nullptr, hugeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (m_base != MAP_FAILED)
+        {
+            m_mapSize = hugeSize;
+            m_hugePages = true;
+        }
+    }
+#endif
+    if (m_base == MAP_FAILED)
+    {
+        m_base = mmap(nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (m_base == MAP_FAILED)
+        {
+            cout << "Unable to allocate " << m_mapSize << " bytes of buffers: " << strerror(errno) << endl;
+            m_base = nullptr;
+            m_mapSize = 0;
+            return -1;
+        }
+#ifdef MADV_HUGEPAGE
+        if (hugePages)
+        {
+            // no reserved huge pages; let the kernel back it with THP if it can
+            madvise(m_base, m_mapSize, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    // fault everything in now rather than during capture
+    memset(m_base, 0, m_mapSize);
+
+    m_bufferSize = bufferSize;
+    m_buffers.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        m_buffers[i] = static_cast<char*>(m_base) + i * stride;
+    }
+    return 0;
+}
+
+void BufferPool::Free()
+{
+    if (m_base != nullptr)
+    {
+        munmap(m_base, m_mapSize);
+    }
+    m_base = nullptr;
+    m_mapSize = 0;
+    m_bufferSize = 0;
+    m_buffers.clear();
+    m_hugePages = false;
+}
+
+int ConfigureUserBuffers(CameraPtr pCam, INodeMap& nodeMap, size_t numBuffers, bool hugePages, BufferPool& pool)
+{
+    // Buffer count follows from the memory we hand over, so the mode must be manual
+    INodeMap& sNodeMap = pCam->GetTLStreamNodeMap();
+    CEnumerationPtr ptrStreamBufferCountMode = sNodeMap.GetNode("StreamBufferCountMode");
+    if (!IsReadable(ptrStreamBufferCountMode) || !IsWritable(ptrStreamBufferCountMode))
+    {
+        cout << "Unable to get or set Buffer Count Mode. Aborting..." << endl << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrStreamBufferCountModeManual = ptrStreamBufferCountMode->GetEntryByName("Manual");
+    if (!IsReadable(ptrStreamBufferCountModeManual))
+    {
+        cout << "Unable to get Buffer Count Mode entry. Aborting..." << endl << endl;
+        return -1;
+    }
+    ptrStreamBufferCountMode->SetIntValue(ptrStreamBufferCountModeManual->GetValue());
+
+    CIntegerPtr ptrPayloadSize = nodeMap.GetNode("PayloadSize");
+    if (!IsReadable(ptrPayloadSize))
+    {
+        cout << "Unable to determine the payload size from the nodemap. Aborting..." << endl << endl;
+        return -1;
+    }
+    uint64_t bufferSize = ptrPayloadSize->GetValue();
+
+    // USB3 transfers are in 1024 byte packets; a short last packet tears the image
+    CEnumerationPtr ptrDeviceType = pCam->GetTLDeviceNodeMap().GetNode("DeviceType");
+    if (ptrDeviceType != nullptr && ptrDeviceType->GetIntValue() == DeviceType_USB3Vision)
+    {
+        const uint64_t usbPacketSize = 1024;
+        bufferSize = ((bufferSize + usbPacketSize - 1) / usbPacketSize) * usbPacketSize;
+    }
+
+    if (pool.Allocate(numBuffers, (size_t)bufferSize, hugePages) != 0)
+    {
+        return -1;
+    }
+
+    if (pCam->GetBufferOwnership() != SPINNAKER_BUFFER_OWNERSHIP_USER)
+    {
+        pCam->SetBufferOwnership(SPINNAKER_BUFFER_OWNERSHIP_USER);
+    }
+    pCam->SetUserBuffers(pool.GetBufferList(), pool.GetCount(), pool.GetBufferSize());
+
+    cout << "Using " << pool.GetCount() << " user stream buffers of " << pool.GetBufferSize() << " bytes"
+         << (pool.IsHugePageBacked() ? " (huge pages)" : "") << "..." << endl;
+    return 0;
+}
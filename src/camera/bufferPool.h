@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include <stddef.h>
+#include <vector>
+
+// Equally sized, page-aligned buffers carved out of one anonymous mapping.
+// The whole region is touched on allocation so no page faults happen mid-scan.
+class BufferPool
+{
+public:
+    BufferPool();
+    ~BufferPool();
+
+    // hugePages asks for MAP_HUGETLB and falls back to transparent huge pages
+    // (or ordinary pages off Linux) when none are reserved
+    int Allocate(size_t count, size_t bufferSize, bool hugePages);
+    void Free();
+
+    size_t GetCount() const { return m_buffers.size(); }
+    size_t GetBufferSize() const { return m_bufferSize; }
+    void* GetBuffer(size_t i) const { return m_buffers[i]; }
+    void** GetBufferList() { return m_buffers.data(); }
+    bool IsHugePageBacked() const { return m_hugePages; }
+
+private:
+    BufferPool(const BufferPool&);
+    BufferPool& operator=(const BufferPool&);
+
+    void* m_base;
+    size_t m_mapSize;
+    size_t m_bufferSize;
+    std::vector<void*> m_buffers;
+    bool m_hugePages;
+};
+
+// Hands numBuffers user-owned stream buffers to the camera, as in the
+// AcquisitionUserBuffer sample. Must be called before BeginAcquisition and the
+// pool must outlive EndAcquisition.
+int ConfigureUserBuffers(Spinnaker::CameraPtr pCam, Spinnaker::GenApi::INodeMap& nodeMap, size_t numBuffers,
+                         bool hugePages, BufferPool& pool);
@@ -0,0 +1,758 @@
+#include "captureConfig.h"
+#include <iostream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+using namespace std;
+
+CaptureConfig::CaptureConfig()
+    : numphoto(0),
+      slideSize(1),
+      allCameras(false),
+      daemonSocket("/tmp/camrunner.sock"),
+      source(SOURCE_CAMERA),
+      replayDir("."),
+      replayJitterUs(0.0),
+      replayDropRate(0.0),
+      replayIncompleteRate(0.0),
+      replaySeed(1),
+      frameRate(0.0),
+      scanSeconds(0.0),
+      stageStepHz(250.0),
+      stageProfile(STAGE_PROFILE_CONSTANT),
+      stageAccel(2000.0),
+      stageJerk(20000.0),
+      triggerSteps(100),
+      roiWidth(0),
+      roiHeight(0),
+      roiOffsetX(0),
+      roiOffsetY(0),
+      binning(1),
+      decimation(1),
+      sharpness(false),
+      minSharpness(0.0),
+      sharpnessDecimation(4),
+      selectMotion(false),
+      selectFraction(0.25),
+      selectMaxSkip(0),
+      useUserSet(true),
+      useChunkData(true),
+      output(OUTPUT_JPEG),
+      filePrefix("SuperStitch"),
+      captureName("SuperStitch"),
+      preallocBytes(1024ULL * 1024 * 1024),
+      jpegQuality(75),
+      jpegRestartRows(0),
+      compression(false),
+      decompressionThreads(0),
+      storeCompressed(false),
+      userBuffers(0),
+      hugePages(false),
+      streamBuffers(0),
+      metrics(false),
+      metricsInterval(5.0),
+      numWorkers(1),
+      queueCapacity(64),
+      backpressure(BACKPRESSURE_BLOCK)
+{
+    // leave one core for the grab thread
+    const unsigned int cores = thread::hardware_concurrency();
+    if (cores > 1)
+    {
+        numWorkers = cores - 1;
+    }
+}
+
+static bool ParseDouble(const string& value, double& out)
+{
+    if (value.empty())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    out = strtod(value.c_str(), &end);
+    return *end == '\0';
+}
+
+static bool ParseSwitch(const string& value, bool& out)
+{
+    if (value == "on" || value == "1" || value == "true")
+    {
+        out = true;
+        return true;
+    }
+    if (value == "off" || value == "0" || value == "false")
+    {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+static bool ParseUnsigned(const string& value, unsigned long& out)
+{
+    if (value.empty())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    out = strtoul(value.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+// WxH+X+Y, with the offset optional
+static bool ParseRegion(const string& value, size_t& width, size_t& height, size_t& offsetX, size_t& offsetY)
+{
+    unsigned long w = 0, h = 0, x = 0, y = 0;
+    int used = 0;
+    if (sscanf(value.c_str(), "%lux%lu%n", &w, &h, &used) != 2 || w == 0 || h == 0)
+    {
+        return false;
+    }
+    if (value[used] != '\0')
+    {
+        const char* offset = value.c_str() + used;
+        int offsetUsed = 0;
+        if (sscanf(offset, "+%lu+%lu%n", &x, &y, &offsetUsed) != 2 || offset[offsetUsed] != '\0')
+        {
+            return false;
+        }
+    }
+    width = w;
+    height = h;
+    offsetX = x;
+    offsetY = y;
+    return true;
+}
+
+int SetCaptureOption(CaptureConfig& config, const string& key, const string& value)
+{
+    unsigned long number = 0;
+
+    if (key == "workers")
+    {
+        if (!ParseUnsigned(value, number) || number == 0)
+        {
+            cout << "--workers needs a positive integer" << endl;
+            return -1;
+        }
+        config.numWorkers = (unsigned int)number;
+    }
+    else if (key == "queue")
+    {
+        if (!ParseUnsigned(value, number) || number == 0)
+        {
+            cout << "--queue needs a positive integer" << endl;
+            return -1;
+        }
+        config.queueCapacity = (size_t)number;
+    }
+    else if (key == "backpressure")
+    {
+        if (value == "block")
+        {
+            config.backpressure = BACKPRESSURE_BLOCK;
+        }
+        else if (value == "drop")
+        {
+            config.backpressure = BACKPRESSURE_DROP_NEWEST;
+        }
+        else
+        {
+            cout << "--backpressure must be block or drop" << endl;
+            return -1;
+        }
+    }
+    else if (key == "frame-rate")
+    {
+        if (!ParseDouble(value, config.frameRate) || config.frameRate < 0)
+        {
+            cout << "--frame-rate needs a non-negative number of frames per second" << endl;
+            return -1;
+        }
+    }
+    else if (key == "scan-seconds")
+    {
+        if (!ParseDouble(value, config.scanSeconds) || config.scanSeconds < 0)
+        {
+            cout << "--scan-seconds needs a non-negative number" << endl;
+            return -1;
+        }
+    }
+    else if (key == "step-hz")
+    {
+        if (!ParseDouble(value, config.stageStepHz) || config.stageStepHz <= 0)
+        {
+            cout << "--step-hz needs a positive step rate" << endl;
+            return -1;
+        }
+    }
+    else if (key == "profile")
+    {
+        if (value == "constant")
+        {
+            config.stageProfile = STAGE_PROFILE_CONSTANT;
+        }
+        else if (value == "trapezoid")
+        {
+            config.stageProfile = STAGE_PROFILE_TRAPEZOID;
+        }
+        else if (value == "scurve")
+        {
+            config.stageProfile = STAGE_PROFILE_SCURVE;
+        }
+        else
+        {
+            cout << "--profile must be constant, trapezoid or scurve" << endl;
+            return -1;
+        }
+    }
+    else if (key == "accel")
+    {
+        if (!ParseDouble(value, config.stageAccel) || config.stageAccel <= 0)
+        {
+            cout << "--accel needs a positive acceleration in steps/s^2" << endl;
+            return -1;
+        }
+    }
+    else if (key == "jerk")
+    {
+        if (!ParseDouble(value, config.stageJerk) || config.stageJerk <= 0)
+        {
+            cout << "--jerk needs a positive jerk in steps/s^3" << endl;
+            return -1;
+        }
+    }
+    else if (key == "chunk-data")
+    {
+        if (!ParseSwitch(value, config.useChunkData))
+        {
+            cout << "--chunk-data must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "output")
+    {
+        if (value == "jpeg")
+        {
+            config.output = OUTPUT_JPEG;
+        }
+        else if (value == "container")
+        {
+            config.output = OUTPUT_CONTAINER;
+        }
+        else
+        {
+            cout << "--output must be jpeg or container" << endl;
+            return -1;
+        }
+    }
+    else if (key == "capture-name")
+    {
+        if (value.empty())
+        {
+            cout << "--capture-name needs a file name" << endl;
+            return -1;
+        }
+        config.captureName = value;
+    }
+    else if (key == "prealloc-mb")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--prealloc-mb needs a non-negative integer" << endl;
+            return -1;
+        }
+        config.preallocBytes = (uint64_t)number * 1024 * 1024;
+    }
+    else if (key == "jpeg-quality")
+    {
+        if (!ParseUnsigned(value, number) || number < 1 || number > 100)
+        {
+            cout << "--jpeg-quality must be between 1 and 100" << endl;
+            return -1;
+        }
+        config.jpegQuality = (int)number;
+    }
+    else if (key == "jpeg-restart")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--jpeg-restart needs a non-negative number of MCU rows" << endl;
+            return -1;
+        }
+        config.jpegRestartRows = (unsigned int)number;
+    }
+    else if (key == "user-buffers")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--user-buffers needs a non-negative integer" << endl;
+            return -1;
+        }
+        config.userBuffers = (size_t)number;
+    }
+    else if (key == "hugepages")
+    {
+        if (!ParseSwitch(value, config.hugePages))
+        {
+            cout << "--hugepages must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "buffer-handling")
+    {
+        if (value != "OldestFirst" && value != "OldestFirstOverwrite" && value != "NewestFirst" &&
+            value != "NewestOnly")
+        {
+            cout << "--buffer-handling must be OldestFirst, OldestFirstOverwrite, NewestFirst or NewestOnly" << endl;
+            return -1;
+        }
+        config.bufferHandling = value;
+    }
+    else if (key == "stream-buffers")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--stream-buffers needs a non-negative integer" << endl;
+            return -1;
+        }
+        config.streamBuffers = (size_t)number;
+    }
+    else if (key == "cameras")
+    {
+        if (value == "first")
+        {
+            config.allCameras = false;
+        }
+        else if (value == "all")
+        {
+            config.allCameras = true;
+        }
+        else
+        {
+            cout << "--cameras must be first or all" << endl;
+            return -1;
+        }
+    }
+    else if (key == "compression")
+    {
+        if (!ParseSwitch(value, config.compression))
+        {
+            cout << "--compression must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "decompression-threads")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--decompression-threads needs a non-negative integer" << endl;
+            return -1;
+        }
+        config.decompressionThreads = (unsigned int)number;
+    }
+    else if (key == "store-compressed")
+    {
+        if (!ParseSwitch(value, config.storeCompressed))
+        {
+            cout << "--store-compressed must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "metrics")
+    {
+        if (!ParseSwitch(value, config.metrics))
+        {
+            cout << "--metrics must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "metrics-interval")
+    {
+        if (!ParseDouble(value, config.metricsInterval) || config.metricsInterval <= 0)
+        {
+            cout << "--metrics-interval needs a positive number of seconds" << endl;
+            return -1;
+        }
+    }
+    else if (key == "source")
+    {
+        if (value == "camera")
+        {
+            config.source = SOURCE_CAMERA;
+        }
+        else if (value == "replay")
+        {
+            config.source = SOURCE_REPLAY;
+        }
+        else
+        {
+            cout << "--source must be camera or replay" << endl;
+            return -1;
+        }
+    }
+    else if (key == "replay-dir")
+    {
+        if (value.empty())
+        {
+            cout << "--replay-dir needs a directory" << endl;
+            return -1;
+        }
+        config.replayDir = value;
+    }
+    else if (key == "replay-jitter-us")
+    {
+        if (!ParseDouble(value, config.replayJitterUs) || config.replayJitterUs < 0)
+        {
+            cout << "--replay-jitter-us needs a non-negative number" << endl;
+            return -1;
+        }
+    }
+    else if (key == "replay-drop")
+    {
+        if (!ParseDouble(value, config.replayDropRate) || config.replayDropRate < 0 || config.replayDropRate >= 1)
+        {
+            cout << "--replay-drop needs a fraction in [0, 1)" << endl;
+            return -1;
+        }
+    }
+    else if (key == "replay-incomplete")
+    {
+        if (!ParseDouble(value, config.replayIncompleteRate) || config.replayIncompleteRate < 0 ||
+            config.replayIncompleteRate > 1)
+        {
+            cout << "--replay-incomplete needs a fraction in [0, 1]" << endl;
+            return -1;
+        }
+    }
+    else if (key == "replay-seed")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--replay-seed needs a non-negative integer" << endl;
+            return -1;
+        }
+        config.replaySeed = (unsigned int)number;
+    }
+    else if (key == "trigger")
+    {
+        if (value == "off")
+        {
+            config.triggerLine.clear();
+        }
+        else if (value == "Line0" || value == "Line1" || value == "Line2" || value == "Line3")
+        {
+            config.triggerLine = value;
+        }
+        else
+        {
+            cout << "--trigger must be off, Line0, Line1, Line2 or Line3" << endl;
+            return -1;
+        }
+    }
+    else if (key == "trigger-steps")
+    {
+        if (!ParseUnsigned(value, number) || number == 0)
+        {
+            cout << "--trigger-steps needs a positive integer" << endl;
+            return -1;
+        }
+        config.triggerSteps = (unsigned int)number;
+    }
+    else if (key == "socket")
+    {
+        if (value.empty())
+        {
+            cout << "--socket needs a path" << endl;
+            return -1;
+        }
+        config.daemonSocket = value;
+    }
+    else if (key == "dark")
+    {
+        config.darkFrame = value;
+    }
+    else if (key == "flat")
+    {
+        config.flatFrame = value;
+    }
+    else if (key == "sharpness")
+    {
+        if (!ParseSwitch(value, config.sharpness))
+        {
+            cout << "--sharpness must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "min-sharpness")
+    {
+        if (!ParseDouble(value, config.minSharpness) || config.minSharpness < 0)
+        {
+            cout << "--min-sharpness needs a non-negative number" << endl;
+            return -1;
+        }
+        if (config.minSharpness > 0)
+        {
+            config.sharpness = true;
+        }
+    }
+    else if (key == "sharpness-decimation")
+    {
+        if (!ParseUnsigned(value, number) || number == 0 || number > 16)
+        {
+            cout << "--sharpness-decimation needs an integer from 1 to 16" << endl;
+            return -1;
+        }
+        config.sharpnessDecimation = (unsigned int)number;
+    }
+    else if (key == "userset")
+    {
+        if (!ParseSwitch(value, config.useUserSet))
+        {
+            cout << "--userset must be on or off" << endl;
+            return -1;
+        }
+    }
+    else if (key == "select")
+    {
+        if (value == "all")
+        {
+            config.selectMotion = false;
+        }
+        else if (value == "motion")
+        {
+            config.selectMotion = true;
+        }
+        else
+        {
+            cout << "--select must be all or motion" << endl;
+            return -1;
+        }
+    }
+    else if (key == "select-fraction")
+    {
+        if (!ParseDouble(value, config.selectFraction) || config.selectFraction <= 0 || config.selectFraction > 1)
+        {
+            cout << "--select-fraction needs a number above 0 and at most 1" << endl;
+            return -1;
+        }
+    }
+    else if (key == "select-max-skip")
+    {
+        if (!ParseUnsigned(value, number))
+        {
+            cout << "--select-max-skip needs a non-negative integer" << endl;
+            return -1;
+        }
+        config.selectMaxSkip = (unsigned int)number;
+    }
+    else if (key == "roi")
+    {
+        if (value == "full")
+        {
+            config.roiWidth = config.roiHeight = config.roiOffsetX = config.roiOffsetY = 0;
+        }
+        else if (!ParseRegion(value, config.roiWidth, config.roiHeight, config.roiOffsetX, config.roiOffsetY))
+        {
+            cout << "--roi must be full or WIDTHxHEIGHT[+X+Y], e.g. 1280x960+80+60" << endl;
+            return -1;
+        }
+    }
+    else if (key == "binning" || key == "decimation")
+    {
+        if (!ParseUnsigned(value, number) || (number != 1 && number != 2 && number != 4))
+        {
+            cout << "--" << key << " must be 1, 2 or 4" << endl;
+            return -1;
+        }
+        (key == "binning" ? config.binning : config.decimation) = (unsigned int)number;
+    }
+    else if (key == "preview")
+    {
+        // overview pass: bin the whole sensor rather than crop it
+        if (value == "off")
+        {
+            config.binning = 1;
+        }
+        else if (value == "2" || value == "4")
+        {
+            config.binning = (unsigned int)atoi(value.c_str());
+            config.roiWidth = config.roiHeight = config.roiOffsetX = config.roiOffsetY = 0;
+        }
+        else
+        {
+            cout << "--preview must be off, 2 or 4" << endl;
+            return -1;
+        }
+    }
+    else
+    {
+        cout << "Unknown option --" << key << endl;
+        return -1;
+    }
+
+    return 0;
+}
+
+int ParseCaptureArgs(int argc, char* argv[], int first, CaptureConfig& config)
+{
+    for (int i = first; i < argc; i++)
+    {
+        const string arg = argv[i];
+        const size_t eq = arg.find('=');
+        if (arg.compare(0, 2, "--") != 0 || eq == string::npos)
+        {
+            cout << "Malformed option " << arg << ", expected --key=value" << endl;
+            return -1;
+        }
+
+        if (SetCaptureOption(config, arg.substr(2, eq - 2), arg.substr(eq + 1)) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int ScanRows(const CaptureConfig& config)
+{
+    // same size_file.txt mapping as the stage controller
+    return config.slideSize == 2 ? 20 : 10;
+}
+
+// Time to ramp from rest to velocity and the distance covered doing it, as
+// motion_ramp in stageTranslationFiles/motion_profile.h
+static void StageRamp(const CaptureConfig& config, double velocity, double& seconds, double& steps)
+{
+    const double accel = config.stageAccel;
+    const double jerk = config.stageJerk;
+    if (config.stageProfile == STAGE_PROFILE_SCURVE && velocity * jerk < accel * accel)
+    {
+        seconds = 2.0 * sqrt(velocity / jerk);
+    }
+    else if (config.stageProfile == STAGE_PROFILE_SCURVE)
+    {
+        seconds = accel / jerk + velocity / accel;
+    }
+    else
+    {
+        seconds = velocity / accel;
+    }
+    steps = velocity * seconds / 2.0;
+}
+
+double StageMoveSeconds(const CaptureConfig& config, double steps)
+{
+    double velocity = config.stageStepHz;
+    if (config.stageProfile == STAGE_PROFILE_CONSTANT)
+    {
+        return steps / velocity;
+    }
+
+    double rampSeconds, rampSteps;
+    StageRamp(config, velocity, rampSeconds, rampSteps);
+    if (2.0 * rampSteps > steps)
+    {
+        // too short to reach the step rate: find the peak whose two ramps fill the move
+        double low = 0.0;
+        double high = velocity;
+        for (int i = 0; i < 60; i++)
+        {
+            const double middle = 0.5 * (low + high);
+            StageRamp(config, middle, rampSeconds, rampSteps);
+            if (2.0 * rampSteps > steps)
+            {
+                high = middle;
+            }
+            else
+            {
+                low = middle;
+            }
+        }
+        velocity = low;
+        StageRamp(config, velocity, rampSeconds, rampSteps);
+    }
+    return 2.0 * rampSeconds + (steps - 2.0 * rampSteps) / velocity;
+}
+
+int ScanFrameCount(const CaptureConfig& config)
+{
+    double seconds = config.scanSeconds;
+    if (seconds <= 0)
+    {
+        // each row is one X move and one Y move
+        const double rowSeconds = StageMoveSeconds(config, STAGE_X_STEPS) + StageMoveSeconds(config, STAGE_Y_STEPS);
+        seconds = ScanRows(config) * (rowSeconds + STAGE_ROW_OVERHEAD_S);
+    }
+    return (int)(seconds * config.frameRate + 0.5);
+}
+
+int ScanTriggerCount(const CaptureConfig& config)
+{
+    // translate.cpp fires before the step at x % N == 0: x = 0..MAX-1 on the
+    // way out, x = MAX..1 on the way back, alternating rows
+    const int out = (STAGE_X_STEPS + config.triggerSteps - 1) / config.triggerSteps;
+    const int back = STAGE_X_STEPS / config.triggerSteps;
+    const int rows = ScanRows(config);
+    return ((rows + 1) / 2) * out + (rows / 2) * back;
+}
+
+void PrintCaptureUsage()
+{
+    cout << "Usage: camrunner <slide size> [--key=value ...]" << endl
+         << "       camrunner daemon [--socket=PATH] [--key=value ...]" << endl
+         << "       camrunner provision [--roi=... --binning=N --decimation=N]" << endl
+         << "  --socket=PATH           daemon command socket (default /tmp/camrunner.sock)" << endl
+         << "  --workers=N             conversion/save threads (default: cores - 1)" << endl
+         << "  --queue=N               frames buffered between grab and workers (default 64)" << endl
+         << "  --backpressure=block|drop  behaviour when the queue is full (default block)" << endl
+         << "  --frame-rate=HZ         camera-clocked capture at HZ instead of the sleep loop" << endl
+         << "  --scan-seconds=S        capture duration for --frame-rate (default: from stage geometry)" << endl
+         << "  --step-hz=N             stage step rate, as passed to translate (default 250)" << endl
+         << "  --profile=constant|trapezoid|scurve  stage move profile, as passed to translate (default" << endl
+         << "                          constant); with --accel=A and --jerk=J (default 2000, 20000)" << endl
+         << "  --trigger=off|LineN     expose on the stage's trigger pulse on camera input LineN (default off)" << endl
+         << "  --trigger-steps=N       X steps between triggers, as passed to translate (default 100)" << endl
+         << "  --roi=WxH[+X+Y]|full    sensor region in full-resolution pixels, e.g. to crop vignetted" << endl
+         << "                          borders (default full)" << endl
+         << "  --binning=1|2|4         average NxN sensor pixels (default 1)" << endl
+         << "  --decimation=1|2|4      read every Nth row and column (default 1)" << endl
+         << "  --preview=off|2|4       low-resolution overview: full sensor binned 2x2 or 4x4" << endl
+         << "  --dark=FILE.pgm         dark frame subtracted from every frame, same size as the capture" << endl
+         << "  --flat=FILE.pgm         flat frame; each frame is scaled so it corrects to its mean" << endl
+         << "  --sharpness=on|off      variance-of-Laplacian focus score per frame in SuperStitch-frames.csv" << endl
+         << "  --min-sharpness=S       drop frames scoring below S before encoding (implies --sharpness=on)" << endl
+         << "  --sharpness-decimation=N  score on an NxN box-averaged copy (default 4)" << endl
+         << "  --select=all|motion     keep every frame, or only frames the view has moved enough since the" << endl
+         << "                          last kept one, measured by phase correlation (default all)" << endl
+         << "  --select-fraction=F     motion between kept frames as a fraction of the frame (default 0.25)" << endl
+         << "  --select-max-skip=N     with --select=motion, keep at least every Nth frame (default 0, no limit)" << endl
+         << "  --userset=on|off        load User Set 1 when provisioned for these settings (default on)" << endl
+         << "  --chunk-data=on|off     camera timestamps/frame IDs in SuperStitch-frames.csv (default on)" << endl
+         << "  --output=jpeg|container one JPEG per frame, or raw frames in <name>.ssd/.ssi (default jpeg)" << endl
+         << "  --capture-name=NAME     container base name (default SuperStitch)" << endl
+         << "  --prealloc-mb=N         container disk reservation step (default 1024)" << endl
+         << "  --jpeg-quality=Q        JPEG quality 1-100 (default 75)" << endl
+         << "  --jpeg-restart=N        JPEG restart marker every N MCU rows (default 0, none)" << endl
+         << "  --compression=on|off    camera-side lossless compression (default off)" << endl
+         << "  --decompression-threads=N  decode threads per worker (default: cores / workers)" << endl
+         << "  --store-compressed=on|off  keep compressed payloads (.raw / container) and decode later" << endl
+         << "  --user-buffers=N        register N preallocated stream buffers (default 0, library owned)" << endl
+         << "  --hugepages=on|off      back user buffers with huge pages when available (default off)" << endl
+         << "  --buffer-handling=MODE  StreamBufferHandlingMode: OldestFirst, OldestFirstOverwrite, NewestFirst," << endl
+         << "                          NewestOnly (default: driver setting)" << endl
+         << "  --stream-buffers=N      StreamBufferCountManual (default: driver setting)" << endl
+         << "  --cameras=first|all     acquire from every detected camera, one thread each; files are" << endl
+         << "                          tagged SuperStitch_<serial> (default first)" << endl
+         << "  --source=camera|replay  replay recorded frames instead of using a camera (default camera)" << endl
+         << "  --replay-dir=DIR        .jpg/.png frames to replay, in name order (default .)" << endl
+         << "  --replay-jitter-us=N    +/- jitter on replayed frame times, paced by --frame-rate" << endl
+         << "  --replay-drop=F         fraction of replayed frames dropped (FrameID gaps)" << endl
+         << "  --replay-incomplete=F   fraction of replayed frames delivered incomplete" << endl
+         << "  --replay-seed=N         seed for the injected faults (default 1)" << endl
+         << "  --metrics=on|off        stage latency histograms, queue depth and stream counters in" << endl
+         << "                          SuperStitch-metrics.prom, Prometheus text format (default off)" << endl
+         << "  --metrics-interval=S    seconds between metrics file rewrites (default 5)" << endl;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Stage geometry, mirrors the constants in stageTranslationFiles/translate.cpp
+#define STAGE_X_STEPS 7000
+#define STAGE_Y_STEPS 300
+#define STAGE_ROW_OVERHEAD_S 0.004 // per row: 1 ms start lead of each of the two moves, 1 ms loop yield after each
+#define STAGE_TRIGGER_GPIO 60      // TRIGGER_PIN, wired to the camera's trigger line
+
+// Step timing of translate's moves (its --profile), see
+// stageTranslationFiles/motion_profile.h
+enum StageProfile
+{
+    STAGE_PROFILE_CONSTANT = 0,  // every step at the step rate
+    STAGE_PROFILE_TRAPEZOID = 1, // constant acceleration up to the step rate and back down
+    STAGE_PROFILE_SCURVE = 2     // the same with jerk-limited acceleration
+};
+
+// What the grab thread does when the processing queue is full
+enum BackpressurePolicy
+{
+    BACKPRESSURE_BLOCK = 0,     // wait for a worker to free a slot
+    BACKPRESSURE_DROP_NEWEST = 1 // release the new frame and count it as dropped
+};
+
+// Where frames end up
+enum OutputFormat
+{
+    OUTPUT_JPEG = 0,     // one SuperStitch-<t>.jpg per frame
+    OUTPUT_CONTAINER = 1 // raw frames in <name>.ssd indexed by <name>.ssi
+};
+
+// Where frames come from
+enum FrameSourceType
+{
+    SOURCE_CAMERA = 0, // first (or every) Spinnaker camera
+    SOURCE_REPLAY = 1  // recorded frames from replayDir, no hardware needed
+};
+
+// Run-time settings for camrunner. Everything after the slide size argument is
+// given as --key=value, e.g. "camrunner 1 --workers=4 --queue=128".
+struct CaptureConfig
+{
+    CaptureConfig();
+
+    int numphoto;
+    int slideSize;
+
+    // Run every detected camera instead of only the first
+    bool allCameras;
+
+    // camrunner daemon: Unix socket the stage controller talks to
+    std::string daemonSocket;
+
+    // Replay recorded frames instead; paced at frameRate (0 unpaced)
+    FrameSourceType source;
+    std::string replayDir;
+    double replayJitterUs;       // uniform +/- jitter on each frame's due time
+    double replayDropRate;       // fraction of frames dropped before delivery
+    double replayIncompleteRate; // fraction of frames delivered incomplete
+    unsigned int replaySeed;
+
+    // Camera-timed capture; 0 keeps the legacy grab/sleep(70ms) loop
+    double frameRate;
+    double scanSeconds; // 0 derives the scan duration from the stage geometry
+
+    // translate's step timing, for the derived scan duration; must match the
+    // --step-hz/--profile/--accel/--jerk translate runs with
+    double stageStepHz;
+    StageProfile stageProfile;
+    double stageAccel; // steps/s^2
+    double stageJerk;  // steps/s^3
+
+    // Hardware trigger from the stage every triggerSteps X steps; empty
+    // triggerLine leaves the camera free-running
+    std::string triggerLine; // TriggerSource entry, e.g. Line0
+    unsigned int triggerSteps;
+
+    // Sensor readout. The region is in full-resolution sensor pixels and is
+    // scaled by binning and decimation; a 0 width/height keeps the whole sensor
+    size_t roiWidth;
+    size_t roiHeight;
+    size_t roiOffsetX;
+    size_t roiOffsetY;
+    unsigned int binning;    // BinningHorizontal/Vertical, averaged; 1 for none
+    unsigned int decimation; // DecimationHorizontal/Vertical; 1 for none
+
+    // Dark/flat-field correction from binary PGM calibration frames; empty
+    // paths for none
+    std::string darkFrame;
+    std::string flatFrame;
+
+    // Focus scoring before encode; frames under minSharpness (when > 0) are
+    // dropped as blurry
+    bool sharpness;
+    double minSharpness;
+    unsigned int sharpnessDecimation;
+
+    // Motion-aware selection: keep a frame only once the view has moved
+    // selectFraction of the frame since the last kept one
+    bool selectMotion;
+    double selectFraction;
+    unsigned int selectMaxSkip; // keep at least every Nth frame; 0 for no limit
+
+    // Load UserSet1 at startup when "camrunner provision" saved it for these
+    // settings, instead of writing exposure/gain/region nodes one by one
+    bool useUserSet;
+
+    // Record FrameID/Timestamp/ExposureTime/Gain chunks instead of host time
+    bool useChunkData;
+
+    // Output
+    OutputFormat output;
+    std::string filePrefix; // <prefix>-<seconds>.jpg and <prefix>-frames.csv
+    std::string captureName;
+    uint64_t preallocBytes; // container data file is reserved this far ahead
+    int jpegQuality;              // 1-100
+    unsigned int jpegRestartRows; // restart marker every N MCU rows, 0 for none
+
+    // Camera-side lossless compression
+    bool compression;
+    unsigned int decompressionThreads; // per worker; 0 splits the cores between workers
+    bool storeCompressed;              // write the compressed payload, decode later
+
+    // Memory; 0 user buffers leaves stream buffer allocation to Spinnaker
+    size_t userBuffers;
+    bool hugePages;
+
+    // Stream; empty/0 keeps the driver defaults
+    std::string bufferHandling; // StreamBufferHandlingMode entry name
+    size_t streamBuffers;       // StreamBufferCountManual
+
+    // Prometheus text metrics in <prefix>-metrics.prom
+    bool metrics;
+    double metricsInterval; // seconds between rewrites
+
+    // Processing pipeline
+    unsigned int numWorkers;
+    size_t queueCapacity;
+    BackpressurePolicy backpressure;
+};
+
+// Applies a single key/value option. Returns 0 on success and -1 if the key is
+// unknown or the value cannot be parsed.
+int SetCaptureOption(CaptureConfig& config, const std::string& key, const std::string& value);
+
+// Parses --key=value options from argv[first] onwards.
+int ParseCaptureArgs(int argc, char* argv[], int first, CaptureConfig& config);
+
+// Number of stage rows scanned for the configured slide size
+int ScanRows(const CaptureConfig& config);
+
+// Seconds translate takes to move steps steps under the configured profile
+double StageMoveSeconds(const CaptureConfig& config, double steps);
+
+// Frames to grab in camera-timed mode: scan duration times frame rate
+int ScanFrameCount(const CaptureConfig& config);
+
+// Frames the stage triggers over a scan: one per triggerSteps X steps per row
+int ScanTriggerCount(const CaptureConfig& config);
+
+void PrintCaptureUsage();
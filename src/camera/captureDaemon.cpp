@@ -0,0 +1,387 @@
+#include "captureDaemon.h"
+#include "runCam.h"
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace std;
+
+// How long start waits for the camera to begin streaming
+#define DAEMON_START_TIMEOUT_MS 5000
+#define DAEMON_POLL_MS 500
+
+static volatile sig_atomic_t daemonSignalled = 0;
+
+static void OnDaemonSignal(int signo)
+{
+    daemonSignalled = 1;
+}
+
+CaptureControl::CaptureControl()
+    : stopRequested(false),
+      m_started(false),
+      m_finished(false),
+      m_result(0)
+{
+}
+
+void CaptureControl::Reset()
+{
+    lock_guard<mutex> lock(m_mutex);
+    stopRequested = false;
+    m_started = false;
+    m_finished = false;
+    m_result = 0;
+}
+
+void CaptureControl::NotifyStarted()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_started = true;
+    }
+    m_changed.notify_all();
+}
+
+void CaptureControl::NotifyFinished(int result)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_finished = true;
+        m_result = result;
+    }
+    m_changed.notify_all();
+}
+
+bool CaptureControl::WaitStarted(int timeoutMs, bool& started)
+{
+    unique_lock<mutex> lock(m_mutex);
+    const bool done = m_changed.wait_for(lock, chrono::milliseconds(timeoutMs),
+                                         [this] { return m_started || m_finished; });
+    started = m_started;
+    return done;
+}
+
+CaptureDaemon::CaptureDaemon(CameraPtr pCam, const CaptureConfig& config)
+    : m_camera(pCam),
+      m_config(config),
+      m_capturing(false),
+      m_lastResult(0)
+{
+}
+
+CaptureDaemon::~CaptureDaemon()
+{
+    Stop();
+}
+
+bool CaptureDaemon::IsCapturing()
+{
+    return m_capturing.load();
+}
+
+void CaptureDaemon::CaptureThread(CaptureConfig config)
+{
+    int result;
+    if (m_camera != nullptr)
+    {
+        result = AcquireImages(m_camera, m_camera->GetNodeMap(), m_camera->GetTLDeviceNodeMap(), config, &m_control);
+    }
+    else
+    {
+        result = RunReplay(config, &m_control);
+    }
+    m_lastResult = result;
+    m_capturing = false;
+    m_control.NotifyFinished(result);
+    cout << "Capture finished (" << result << ")" << endl;
+}
+
+string CaptureDaemon::Start(int slideSize, const string& name)
+{
+    if (IsCapturing())
+    {
+        return "error capture already running";
+    }
+    if (m_capture.joinable())
+    {
+        m_capture.join();
+    }
+
+    CaptureConfig run = m_config;
+    run.slideSize = slideSize;
+    // same photo budget as a one-shot "camrunner <slide size>"
+    run.numphoto = slideSize == 2 ? PHOTO_PER_SLIDE : PHOTO_PER_SLIDE * 2;
+    if (!name.empty())
+    {
+        if (mkdir(name.c_str(), 0777) != 0 && errno != EEXIST)
+        {
+            return "error cannot create " + name + ": " + strerror(errno);
+        }
+        run.filePrefix = name + "/" + m_config.filePrefix;
+        run.captureName = name + "/" + m_config.captureName;
+    }
+
+    m_control.Reset();
+    m_capturing = true;
+    m_capture = thread(&CaptureDaemon::CaptureThread, this, run);
+
+    // reply only once frames are flowing, so the stage's first move lines up
+    // with the start of capture
+    bool started = false;
+    if (!m_control.WaitStarted(DAEMON_START_TIMEOUT_MS, started))
+    {
+        // don't leave a half-started run holding the camera; the thread sees
+        // the stop at its first grab, or fails on its own
+        m_control.stopRequested = true;
+        m_capture.join();
+        return "error camera did not start streaming";
+    }
+    if (!started)
+    {
+        m_capture.join();
+        return "error capture failed (" + to_string(m_lastResult) + ")";
+    }
+    return "ok started";
+}
+
+string CaptureDaemon::Stop()
+{
+    if (!m_capture.joinable())
+    {
+        return "ok idle";
+    }
+    m_control.stopRequested = true;
+    m_capture.join();
+    return "ok stopped " + to_string(m_lastResult);
+}
+
+string CaptureDaemon::Configure(const string& options)
+{
+    if (IsCapturing())
+    {
+        return "error cannot configure while capturing";
+    }
+
+    CaptureConfig updated = m_config;
+    istringstream words(options);
+    string option;
+    while (words >> option)
+    {
+        const size_t eq = option.find('=');
+        if (option.compare(0, 2, "--") != 0 || eq == string::npos)
+        {
+            return "error malformed option " + option;
+        }
+        if (SetCaptureOption(updated, option.substr(2, eq - 2), option.substr(eq + 1)) != 0)
+        {
+            return "error bad option " + option;
+        }
+    }
+
+    // region changes have to reach the camera now; everything else is read
+    // at the next start
+    if (m_camera != nullptr && ConfigureRegion(m_camera->GetNodeMap(), updated) != 0)
+    {
+        ConfigureRegion(m_camera->GetNodeMap(), m_config);
+        return "error camera rejected the region";
+    }
+    m_config = updated;
+    return "ok configured";
+}
+
+string CaptureDaemon::HandleCommand(const string& line, bool& quit)
+{
+    istringstream words(line);
+    string command;
+    words >> command;
+
+    if (command == "start")
+    {
+        int slideSize = 0;
+        string name;
+        if (!(words >> slideSize) || (slideSize != 1 && slideSize != 2))
+        {
+            return "error usage: start <slide size 1|2> [name]";
+        }
+        words >> name;
+        return Start(slideSize, name);
+    }
+    if (command == "stop")
+    {
+        return Stop();
+    }
+    if (command == "configure")
+    {
+        string options;
+        getline(words, options);
+        return Configure(options);
+    }
+    if (command == "status")
+    {
+        return IsCapturing() ? "ok capturing" : "ok idle " + to_string(m_lastResult);
+    }
+    if (command == "quit")
+    {
+        quit = true;
+        Stop();
+        return "ok quitting";
+    }
+    return "error unknown command " + command;
+}
+
+int CaptureDaemon::Run(const string& socketPath)
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        cout << "Socket path " << socketPath << " is too long" << endl;
+        return -1;
+    }
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(listener, 4) != 0)
+    {
+        cout << "Unable to listen on " << socketPath << ": " << strerror(errno) << endl;
+        if (listener >= 0)
+        {
+            close(listener);
+        }
+        return -1;
+    }
+
+    // no SA_RESTART, so poll returns and the loop notices the signal
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = OnDaemonSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    cout << "Camera daemon listening on " << socketPath << endl;
+
+    bool quit = false;
+    while (!quit && !daemonSignalled)
+    {
+        pollfd waiting = {listener, POLLIN, 0};
+        if (poll(&waiting, 1, DAEMON_POLL_MS) <= 0)
+        {
+            continue;
+        }
+        const int client = accept(listener, nullptr, nullptr);
+        if (client < 0)
+        {
+            continue;
+        }
+
+        // one client at a time; each newline-terminated command gets a reply
+        string pending;
+        while (!quit && !daemonSignalled)
+        {
+            pollfd reading = {client, POLLIN, 0};
+            if (poll(&reading, 1, DAEMON_POLL_MS) <= 0)
+            {
+                continue;
+            }
+            char buffer[512];
+            const ssize_t received = read(client, buffer, sizeof(buffer));
+            if (received <= 0)
+            {
+                break;
+            }
+            pending.append(buffer, (size_t)received);
+
+            size_t newline;
+            while (!quit && (newline = pending.find('\n')) != string::npos)
+            {
+                string line = pending.substr(0, newline);
+                pending.erase(0, newline + 1);
+                if (!line.empty() && line[line.size() - 1] == '\r')
+                {
+                    line.erase(line.size() - 1);
+                }
+                cout << "Command: " << line << endl;
+                const string reply = HandleCommand(line, quit) + "\n";
+                if (write(client, reply.data(), reply.size()) < 0)
+                {
+                    break;
+                }
+            }
+        }
+        close(client);
+    }
+
+    close(listener);
+    unlink(socketPath.c_str());
+    Stop();
+    cout << "Camera daemon stopped" << endl;
+    return 0;
+}
+
+int RunDaemon(const CaptureConfig& config)
+{
+    cout << endl << endl << "*** CAMERA DAEMON ***" << endl << endl;
+
+    if (config.source == SOURCE_REPLAY)
+    {
+        CaptureDaemon daemon(nullptr, config);
+        return daemon.Run(config.daemonSocket);
+    }
+
+    SystemPtr system = System::GetInstance();
+    CameraList camList = system->GetCameras();
+    cout << "Number of cameras detected: " << camList.GetSize() << endl << endl;
+    if (camList.GetSize() == 0)
+    {
+        camList.Clear();
+        system->ReleaseInstance();
+        return -1;
+    }
+    if (config.allCameras)
+    {
+        cout << "The daemon drives the first camera only" << endl;
+    }
+
+    int result = 0;
+    CameraPtr pCam = camList.GetByIndex(0);
+    try
+    {
+        // everything a one-shot run repeats per slide happens once here
+        pCam->Init();
+        INodeMap& nodeMap = pCam->GetNodeMap();
+        if (BringUpCamera(nodeMap, config) < 0)
+        {
+            result = -1;
+        }
+        else
+        {
+            CaptureDaemon daemon(pCam, config);
+            result = daemon.Run(config.daemonSocket);
+        }
+        pCam->DeInit();
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error: " << e.what() << endl;
+        result = -1;
+    }
+
+    pCam = nullptr;
+    camList.Clear();
+    system->ReleaseInstance();
+    return result;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include "captureConfig.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Lets a caller on another thread follow and end one acquisition run.
+// AcquireFrames reports once the source is streaming and checks for a stop
+// request before every grab.
+struct CaptureControl
+{
+    CaptureControl();
+
+    void Reset();
+    void NotifyStarted();
+    void NotifyFinished(int result);
+
+    // Waits until the run is streaming or has ended; false on timeout
+    bool WaitStarted(int timeoutMs, bool& started);
+
+    std::atomic<bool> stopRequested;
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    bool m_started;
+    bool m_finished;
+    int m_result;
+};
+
+// Keeps the camera initialized and configured between slides and runs
+// captures on request, so a scan starts in milliseconds instead of paying for
+// System::GetInstance, GetCameras, Init and the node writes every time.
+//
+// Commands are single text lines on a Unix stream socket, one reply line each:
+//   start <slide size> [name]   capture into directory name; replies once the
+//                               camera is streaming, so the stage can move
+//   stop                        end the running capture and wait for the workers
+//   configure --key=value ...   change capture options while idle
+//   status                      idle or capturing
+//   quit                        stop and shut the daemon down
+// Replies start with "ok" or "error".
+class CaptureDaemon
+{
+public:
+    // pCam may be null when config.source is SOURCE_REPLAY
+    CaptureDaemon(Spinnaker::CameraPtr pCam, const CaptureConfig& config);
+    ~CaptureDaemon();
+
+    // Serves commands until quit or SIGINT/SIGTERM
+    int Run(const std::string& socketPath);
+
+private:
+    CaptureDaemon(const CaptureDaemon&);
+    CaptureDaemon& operator=(const CaptureDaemon&);
+
+    std::string HandleCommand(const std::string& line, bool& quit);
+    std::string Start(int slideSize, const std::string& name);
+    std::string Stop();
+    std::string Configure(const std::string& options);
+    void CaptureThread(CaptureConfig config);
+    bool IsCapturing();
+
+    Spinnaker::CameraPtr m_camera;
+    CaptureConfig m_config;
+    CaptureControl m_control;
+    std::thread m_capture;
+    std::atomic<bool> m_capturing;
+    std::atomic<int> m_lastResult;
+};
+
+// camrunner daemon [--socket=PATH] [--key=value ...]
+int RunDaemon(const CaptureConfig& config);
@@ -0,0 +1,179 @@
+#include "captureFile.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+using namespace std;
+
+CaptureWriter::CaptureWriter()
+    : m_dataFd(-1),
+      m_indexFd(-1),
+      m_dataEnd(0),
+      m_allocated(0),
+      m_preallocChunk(0),
+      m_entryCount(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    Close();
+}
+
+int CaptureWriter::Open(const string& name, uint64_t preallocChunk)
+{
+    const string dataPath = name + ".ssd";
+    const string indexPath = name + ".ssi";
+
+    m_dataFd = open(dataPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    m_indexFd = open(indexPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m_dataFd < 0 || m_indexFd < 0)
+    {
+        cout << "Unable to create capture files " << dataPath << " / " << indexPath << ": " << strerror(errno) << endl;
+        Close();
+        return -1;
+    }
+
+    CaptureIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPTURE_INDEX_MAGIC, sizeof(CAPTURE_INDEX_MAGIC));
+    header.version = CAPTURE_INDEX_VERSION;
+    header.entrySize = sizeof(CaptureIndexEntry);
+    if (write(m_indexFd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+    {
+        cout << "Unable to write capture index header: " << strerror(errno) << endl;
+        Close();
+        return -1;
+    }
+
+    m_dataEnd = 0;
+    m_allocated = 0;
+    m_entryCount = 0;
+    m_preallocChunk = preallocChunk;
+    if (Reserve(m_preallocChunk) != 0)
+    {
+        Close();
+        return -1;
+    }
+
+    cout << "Writing frames to " << dataPath << " (index " << indexPath << ")..." << endl;
+    return 0;
+}
+
+int CaptureWriter::Reserve(uint64_t end)
+{
+    if (end <= m_allocated)
+    {
+        return 0;
+    }
+
+    // grow a whole chunk at a time so extents stay large and contiguous
+    uint64_t target = m_allocated;
+    while (target < end)
+    {
+        target += m_preallocChunk > 0 ? m_preallocChunk : end - target;
+    }
+
+#ifdef __linux__
+    const int err = posix_fallocate(m_dataFd, (off_t)m_allocated, (off_t)(target - m_allocated));
+#else
+    const int err = ftruncate(m_dataFd, (off_t)target) == 0 ? 0 : errno;
+#endif
+    if (err != 0)
+    {
+        cout << "Unable to preallocate capture data file: " << strerror(err) << endl;
+        return -1;
+    }
+    m_allocated = target;
+    return 0;
+}
+
+int64_t CaptureWriter::Append(const void* data, size_t length, const FrameMetadata& meta, uint32_t pixelFormat,
+                              uint32_t width, uint32_t height, uint32_t payloadType)
+{
+    uint64_t offset = 0;
+    {
+        // claim the byte range; the copy itself runs outside the lock
+        lock_guard<mutex> lock(m_mutex);
+        if (m_dataFd < 0)
+        {
+            return -1;
+        }
+        offset = m_dataEnd;
+        if (Reserve(offset + length) != 0)
+        {
+            return -1;
+        }
+        m_dataEnd += length;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    size_t written = 0;
+    while (written < length)
+    {
+        const ssize_t n = pwrite(m_dataFd, bytes + written, length - written, (off_t)(offset + written));
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            cout << "Error writing capture data: " << strerror(errno) << endl;
+            return -1;
+        }
+        written += (size_t)n;
+    }
+
+    CaptureIndexEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.frameId = meta.frameId;
+    entry.deviceTimestamp = meta.deviceTimestamp;
+    entry.hostMonotonicNs = meta.hostMonotonicNs;
+    entry.offset = offset;
+    entry.length = length;
+    entry.pixelFormat = pixelFormat;
+    entry.width = width;
+    entry.height = height;
+    entry.payloadType = payloadType;
+
+    // the index only ever points at data that is already written
+    lock_guard<mutex> lock(m_mutex);
+    if (write(m_indexFd, &entry, sizeof(entry)) != (ssize_t)sizeof(entry))
+    {
+        cout << "Error writing capture index: " << strerror(errno) << endl;
+        return -1;
+    }
+    m_entryCount++;
+    return (int64_t)offset;
+}
+
+void CaptureWriter::Close()
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_dataFd >= 0)
+    {
+        if (ftruncate(m_dataFd, (off_t)m_dataEnd) != 0)
+        {
+            cout << "Unable to trim capture data file: " << strerror(errno) << endl;
+        }
+        close(m_dataFd);
+        m_dataFd = -1;
+    }
+    if (m_indexFd >= 0)
+    {
+        const off_t countOffset = offsetof(CaptureIndexHeader, entryCount);
+        if (pwrite(m_indexFd, &m_entryCount, sizeof(m_entryCount), countOffset) != (ssize_t)sizeof(m_entryCount))
+        {
+            cout << "Unable to finalize capture index: " << strerror(errno) << endl;
+        }
+        close(m_indexFd);
+        m_indexFd = -1;
+    }
+}
+
+uint64_t CaptureWriter::GetEntryCount()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_entryCount;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "frameMetadata.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include <string>
+
+// Capture container: frames are appended back to back into <name>.ssd and
+// described by fixed-size records in <name>.ssi. The index is a header followed
+// by CaptureIndexEntry records, so it can be mmapped and indexed directly.
+// Records are appended in completion order, which with several workers is not
+// strictly FrameID order.
+
+#define CAPTURE_INDEX_MAGIC "SSIDX01"
+#define CAPTURE_INDEX_VERSION 1
+
+struct CaptureIndexHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t entryCount; // written on close; readers can also use the file size
+};
+
+struct CaptureIndexEntry
+{
+    int64_t frameId;
+    int64_t deviceTimestamp;
+    int64_t hostMonotonicNs;
+    uint64_t offset; // into the data file
+    uint64_t length;
+    uint32_t pixelFormat; // Spinnaker PixelFormatEnums value
+    uint32_t width;
+    uint32_t height;
+    uint32_t payloadType; // 0 for plain pixels, else the Spinnaker TLPayloadType (e.g. lossless compressed)
+};
+
+static_assert(sizeof(CaptureIndexHeader) == 24, "index header layout changed");
+static_assert(sizeof(CaptureIndexEntry) == 56, "index entry layout changed");
+
+// Thread-safe writer shared by the pipeline workers
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    // preallocChunk is how far ahead of the write position the data file is
+    // reserved on disk, in bytes
+    int Open(const std::string& name, uint64_t preallocChunk);
+
+    // Appends one frame and its index record. Returns the data offset or -1.
+    int64_t Append(const void* data, size_t length, const FrameMetadata& meta, uint32_t pixelFormat,
+                   uint32_t width, uint32_t height, uint32_t payloadType);
+
+    // Trims the preallocated tail and records the final entry count
+    void Close();
+
+    uint64_t GetEntryCount();
+
+private:
+    int Reserve(uint64_t end);
+
+    int m_dataFd;
+    int m_indexFd;
+    uint64_t m_dataEnd;
+    uint64_t m_allocated;
+    uint64_t m_preallocChunk;
+    uint64_t m_entryCount;
+    std::mutex m_mutex;
+};
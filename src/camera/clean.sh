@@ -3,3 +3,6 @@ parent_path=$( cd "$(dirname "${BASH_SOURCE[0]}")" ; pwd -P )
 cd "$parent_path"
 #rm camrunner 2> /dev/null
 rm -r *.jpg 2> /dev/null
+rm SuperStitch-frames.csv 2> /dev/null
+rm *.ssd *.ssi 2> /dev/null
+rm *.raw *-metrics.prom 2> /dev/null
@@ -0,0 +1,264 @@
+#include "flatField.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <algorithm>
+#include <iostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLAT_FIELD_X86 1
+#endif
+using namespace std;
+
+// Skips whitespace and # comments between PGM header fields
+static int ReadPgmField(FILE* file, unsigned int& value)
+{
+    int c = fgetc(file);
+    while (c == '#' || isspace(c))
+    {
+        if (c == '#')
+        {
+            while (c != '\n' && c != EOF)
+            {
+                c = fgetc(file);
+            }
+        }
+        c = fgetc(file);
+    }
+    if (!isdigit(c))
+    {
+        return -1;
+    }
+    value = 0;
+    while (isdigit(c))
+    {
+        value = value * 10 + (unsigned int)(c - '0');
+        c = fgetc(file);
+    }
+    // exactly one whitespace character separates the header from the data
+    return isspace(c) ? 0 : -1;
+}
+
+int ReadPgm(const string& path, vector<uint16_t>& pixels, size_t& width, size_t& height, unsigned int& maxValue)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        cout << "Unable to open calibration frame " << path << endl;
+        return -1;
+    }
+
+    unsigned int w = 0, h = 0;
+    if (fgetc(file) != 'P' || fgetc(file) != '5' || ReadPgmField(file, w) != 0 || ReadPgmField(file, h) != 0 ||
+        ReadPgmField(file, maxValue) != 0 || w == 0 || h == 0 || maxValue == 0 || maxValue > 65535)
+    {
+        cout << path << " is not a binary (P5) PGM" << endl;
+        fclose(file);
+        return -1;
+    }
+
+    width = w;
+    height = h;
+    const size_t count = width * height;
+    const size_t sampleBytes = maxValue > 255 ? 2 : 1;
+    vector<uint8_t> raw(count * sampleBytes);
+    const size_t read = fread(raw.data(), 1, raw.size(), file);
+    fclose(file);
+    if (read != raw.size())
+    {
+        cout << path << " is truncated" << endl;
+        return -1;
+    }
+
+    // 16-bit PGM samples are big endian
+    pixels.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        pixels[i] = sampleBytes == 2 ? (uint16_t)((raw[2 * i] << 8) | raw[2 * i + 1]) : raw[i];
+    }
+    return 0;
+}
+
+FlatFieldCorrection::FlatFieldCorrection()
+    : m_width(0),
+      m_height(0),
+      m_avx2(false)
+{
+#ifdef FLAT_FIELD_X86
+    m_avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+int FlatFieldCorrection::Load(const string& darkPath, const string& flatPath)
+{
+    vector<uint16_t> dark, flat;
+    size_t darkWidth = 0, darkHeight = 0, flatWidth = 0, flatHeight = 0;
+    unsigned int darkMax = 1, flatMax = 1;
+    if (!darkPath.empty() && ReadPgm(darkPath, dark, darkWidth, darkHeight, darkMax) != 0)
+    {
+        return -1;
+    }
+    if (!flatPath.empty() && ReadPgm(flatPath, flat, flatWidth, flatHeight, flatMax) != 0)
+    {
+        return -1;
+    }
+    if (!dark.empty() && !flat.empty() && (darkWidth != flatWidth || darkHeight != flatHeight))
+    {
+        cout << "Dark frame is " << darkWidth << "x" << darkHeight << " but flat frame is " << flatWidth << "x"
+             << flatHeight << endl;
+        return -1;
+    }
+    m_width = dark.empty() ? flatWidth : darkWidth;
+    m_height = dark.empty() ? flatHeight : darkHeight;
+    const size_t count = m_width * m_height;
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // work in full-scale fractions so 8- and 16-bit calibration frames mix
+    vector<double> darkLevel(count, 0.0);
+    for (size_t i = 0; i < dark.size(); i++)
+    {
+        darkLevel[i] = (double)dark[i] / darkMax;
+    }
+    m_dark8.resize(count);
+    m_dark16.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        m_dark8[i] = (uint16_t)(darkLevel[i] * 255.0 + 0.5);
+        m_dark16[i] = (uint16_t)(darkLevel[i] * 65535.0 + 0.5);
+    }
+
+    const double unity = (double)(1 << FLAT_FIELD_GAIN_BITS);
+    m_gain.assign(count, (uint16_t)unity);
+    if (!flat.empty())
+    {
+        vector<double> signal(count);
+        double sum = 0.0;
+        for (size_t i = 0; i < count; i++)
+        {
+            signal[i] = max((double)flat[i] / flatMax - darkLevel[i], 0.0);
+            sum += signal[i];
+        }
+        const double mean = sum / count;
+        size_t clipped = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            // dead pixels keep unit gain rather than blowing up
+            double gain = signal[i] > 0 ? mean / signal[i] : 1.0;
+            if (gain * unity > 65535.0)
+            {
+                gain = 65535.0 / unity;
+                clipped++;
+            }
+            m_gain[i] = (uint16_t)(gain * unity + 0.5);
+        }
+        if (clipped > 0)
+        {
+            cout << clipped << " flat-field gains clipped at " << 65535.0 / unity << "x" << endl;
+        }
+    }
+
+    cout << "Flat-field correction loaded for " << m_width << "x" << m_height << " frames ("
+         << (m_avx2 ? "AVX2" : "scalar") << ")..." << endl;
+    return 0;
+}
+
+#ifdef FLAT_FIELD_X86
+// 16 pixels per step: widen to 16 bits, saturating subtract of the dark
+// level, then (diff << 2) * gain >> 16 == diff * gain >> 14 in one mulhi.
+// diff << 2 fits since diff <= 255.
+__attribute__((target("avx2"))) static size_t CorrectRow8Avx2(uint8_t* pixels, const uint16_t* dark,
+                                                              const uint16_t* gain, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m256i raw = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x)));
+        const __m256i diff =
+            _mm256_subs_epu16(raw, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dark + x)));
+        const __m256i scaled = _mm256_mulhi_epu16(_mm256_slli_epi16(diff, 2),
+                                                  _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gain + x)));
+        // packus works per 128-bit lane; gather the two low halves
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(scaled, scaled), 0x08);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x), _mm256_castsi256_si128(packed));
+    }
+    return x;
+}
+
+// 16 pixels per step with full 32-bit products from mullo/mulhi, shifted
+// down and packed back with unsigned saturation
+__attribute__((target("avx2"))) static size_t CorrectRow16Avx2(uint16_t* pixels, const uint16_t* dark,
+                                                               const uint16_t* gain, size_t width)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        const __m256i raw = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + x));
+        const __m256i diff =
+            _mm256_subs_epu16(raw, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dark + x)));
+        const __m256i g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gain + x));
+        const __m256i low = _mm256_mullo_epi16(diff, g);
+        const __m256i high = _mm256_mulhi_epu16(diff, g);
+        const __m256i product0 = _mm256_srli_epi32(_mm256_unpacklo_epi16(low, high), FLAT_FIELD_GAIN_BITS);
+        const __m256i product1 = _mm256_srli_epi32(_mm256_unpackhi_epi16(low, high), FLAT_FIELD_GAIN_BITS);
+        // unpack and pack both split at the same lane boundaries, so order is kept
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + x), _mm256_packus_epi32(product0, product1));
+    }
+    return x;
+}
+#endif
+
+void FlatFieldCorrection::Apply8(uint8_t* pixels, size_t width, size_t height, size_t stride) const
+{
+    if (width != m_width || height != m_height)
+    {
+        return;
+    }
+    for (size_t y = 0; y < height; y++)
+    {
+        uint8_t* row = pixels + y * stride;
+        const uint16_t* dark = m_dark8.data() + y * width;
+        const uint16_t* gain = m_gain.data() + y * width;
+        size_t x = 0;
+#ifdef FLAT_FIELD_X86
+        if (m_avx2)
+        {
+            x = CorrectRow8Avx2(row, dark, gain, width);
+        }
+#endif
+        for (; x < width; x++)
+        {
+            const uint32_t diff = row[x] > dark[x] ? row[x] - dark[x] : 0;
+            const uint32_t value = (diff * gain[x]) >> FLAT_FIELD_GAIN_BITS;
+            row[x] = (uint8_t)min(value, 255u);
+        }
+    }
+}
+
+void FlatFieldCorrection::Apply16(uint16_t* pixels, size_t width, size_t height, size_t stride) const
+{
+    if (width != m_width || height != m_height)
+    {
+        return;
+    }
+    for (size_t y = 0; y < height; y++)
+    {
+        uint16_t* row = reinterpret_cast<uint16_t*>(reinterpret_cast<uint8_t*>(pixels) + y * stride);
+        const uint16_t* dark = m_dark16.data() + y * width;
+        const uint16_t* gain = m_gain.data() + y * width;
+        size_t x = 0;
+#ifdef FLAT_FIELD_X86
+        if (m_avx2)
+        {
+            x = CorrectRow16Avx2(row, dark, gain, width);
+        }
+#endif
+        for (; x < width; x++)
+        {
+            const uint32_t diff = row[x] > dark[x] ? row[x] - dark[x] : 0;
+            const uint32_t value = (diff * gain[x]) >> FLAT_FIELD_GAIN_BITS;
+            row[x] = (uint16_t)min(value, 65535u);
+        }
+    }
+}
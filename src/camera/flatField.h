@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Gain map fixed point: 1.0 is 1 << FLAT_FIELD_GAIN_BITS, so gains up to ~4x
+// fit in 16 bits
+#define FLAT_FIELD_GAIN_BITS 14
+
+// Dark-frame and flat-field correction, out = (raw - dark) * gain, applied in
+// place on acquired frames. The dark map is a dark frame (lens capped, same
+// exposure); the gain map is derived from a flat frame (even illumination) so
+// that every pixel of it corrects to the frame's mean. Calibration frames are
+// binary PGMs (P5, 8 or 16 bit) at the capture's frame size, e.g. written from
+// MATLAB with imwrite.
+//
+// The kernels run in 16/32-bit integer arithmetic, with AVX2 when the CPU has
+// it and a scalar loop otherwise; both give identical results. One instance is
+// shared read-only by all workers once loaded.
+class FlatFieldCorrection
+{
+public:
+    FlatFieldCorrection();
+
+    // Either path may be empty: no dark frame subtracts nothing, no flat
+    // frame leaves the gain at 1
+    int Load(const std::string& darkPath, const std::string& flatPath);
+
+    bool IsLoaded() const { return m_width > 0; }
+    size_t GetWidth() const { return m_width; }
+    size_t GetHeight() const { return m_height; }
+    bool UsesAvx2() const { return m_avx2; }
+
+    // Correct width x height pixels, stride bytes per row, in place. The frame
+    // must be the calibration size.
+    void Apply8(uint8_t* pixels, size_t width, size_t height, size_t stride) const;
+    void Apply16(uint16_t* pixels, size_t width, size_t height, size_t stride) const;
+
+private:
+    size_t m_width;
+    size_t m_height;
+    bool m_avx2;
+    std::vector<uint16_t> m_dark8;  // dark level in 8-bit units
+    std::vector<uint16_t> m_dark16; // dark level in 16-bit units
+    std::vector<uint16_t> m_gain;
+};
+
+// Reads a binary PGM into 16-bit samples; maxValue is the PGM's maxval
+int ReadPgm(const std::string& path, std::vector<uint16_t>& pixels, size_t& width, size_t& height,
+            unsigned int& maxValue);
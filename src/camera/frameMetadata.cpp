@@ -0,0 +1,175 @@
+#include "frameMetadata.h"
+#include <chrono>
+#include <iostream>
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace Spinnaker::GenICam;
+using namespace std;
+
+FrameMetadata::FrameMetadata()
+    : hasChunk(false),
+      frameId(-1),
+      deviceTimestamp(0),
+      hostMonotonicNs(0),
+      exposureTime(0.0),
+      gain(0.0),
+      sharpness(-1.0)
+{
+}
+
+ClockLatch::ClockLatch()
+    : valid(false),
+      deviceTicks(0),
+      hostNs(0),
+      tickFrequency(1000000000.0)
+{
+}
+
+int64_t HostMonotonicNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int ConfigureChunkData(INodeMap& nodeMap)
+{
+    CBooleanPtr ptrChunkModeActive = nodeMap.GetNode("ChunkModeActive");
+    if (!IsWritable(ptrChunkModeActive))
+    {
+        cout << "Unable to activate chunk mode..." << endl;
+        return -1;
+    }
+    ptrChunkModeActive->SetValue(true);
+
+    CEnumerationPtr ptrChunkSelector = nodeMap.GetNode("ChunkSelector");
+    if (!IsReadable(ptrChunkSelector) || !IsWritable(ptrChunkSelector))
+    {
+        cout << "Unable to retrieve chunk selector..." << endl;
+        return -1;
+    }
+
+    // Only what we record per frame; every extra chunk costs link bandwidth
+    const char* chunks[] = {"Timestamp", "FrameID", "ExposureTime", "Gain"};
+    int result = 0;
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++)
+    {
+        CEnumEntryPtr ptrChunkSelectorEntry = ptrChunkSelector->GetEntryByName(chunks[i]);
+        if (!IsReadable(ptrChunkSelectorEntry))
+        {
+            cout << "Chunk " << chunks[i] << " not available" << endl;
+            result = -1;
+            continue;
+        }
+        ptrChunkSelector->SetIntValue(ptrChunkSelectorEntry->GetValue());
+
+        CBooleanPtr ptrChunkEnable = nodeMap.GetNode("ChunkEnable");
+        if (!IsAvailable(ptrChunkEnable))
+        {
+            cout << "Chunk " << chunks[i] << " not available" << endl;
+            result = -1;
+        }
+        else if (!ptrChunkEnable->GetValue() && IsWritable(ptrChunkEnable))
+        {
+            ptrChunkEnable->SetValue(true);
+        }
+    }
+
+    cout << "Chunk data enabled..." << endl;
+    return result;
+}
+
+int LatchDeviceClock(INodeMap& nodeMap, ClockLatch& latch)
+{
+    CCommandPtr ptrLatch = nodeMap.GetNode("TimestampLatch");
+    CIntegerPtr ptrLatchValue = nodeMap.GetNode("TimestampLatchValue");
+    if (!IsWritable(ptrLatch) || !IsReadable(ptrLatchValue))
+    {
+        // GigE devices use the GEV names
+        ptrLatch = nodeMap.GetNode("GevTimestampControlLatch");
+        ptrLatchValue = nodeMap.GetNode("GevTimestampValue");
+    }
+    if (!IsWritable(ptrLatch) || !IsReadable(ptrLatchValue))
+    {
+        cout << "Unable to latch device timestamp..." << endl;
+        return -1;
+    }
+
+    CIntegerPtr ptrTickFrequency = nodeMap.GetNode("GevTimestampTickFrequency");
+    if (IsReadable(ptrTickFrequency) && ptrTickFrequency->GetValue() > 0)
+    {
+        latch.tickFrequency = (double)ptrTickFrequency->GetValue();
+    }
+
+    // The latch happens somewhere inside the command round trip; take the midpoint
+    const int64_t before = HostMonotonicNs();
+    ptrLatch->Execute();
+    const int64_t after = HostMonotonicNs();
+
+    latch.deviceTicks = ptrLatchValue->GetValue();
+    latch.hostNs = before + (after - before) / 2;
+    latch.valid = true;
+
+    cout << "Device clock latched at " << latch.deviceTicks << " (host " << latch.hostNs << " ns, +/- "
+         << (after - before) / 2 << " ns)..." << endl;
+    return 0;
+}
+
+void ReadFrameMetadata(const ImagePtr& image, const ClockLatch& latch, FrameMetadata& meta)
+{
+    try
+    {
+        const ChunkData& chunkData = image->GetChunkData();
+        meta.frameId = chunkData.GetFrameID();
+        meta.deviceTimestamp = chunkData.GetTimestamp();
+        meta.exposureTime = chunkData.GetExposureTime();
+        meta.gain = chunkData.GetGain();
+        meta.hasChunk = true;
+    }
+    catch (Spinnaker::Exception&)
+    {
+        // chunk mode is off or unsupported; fall back to the stream's view
+        meta.frameId = (int64_t)image->GetFrameID();
+        meta.deviceTimestamp = (int64_t)image->GetTimeStamp();
+        meta.hasChunk = false;
+    }
+
+    if (latch.valid && meta.deviceTimestamp != 0)
+    {
+        const double deltaNs = (double)(meta.deviceTimestamp - latch.deviceTicks) * (1000000000.0 / latch.tickFrequency);
+        meta.hostMonotonicNs = latch.hostNs + (int64_t)deltaNs;
+    }
+}
+
+int FrameLog::Open(const string& path, const ClockLatch& latch)
+{
+    m_file.open(path.c_str(), ios::out | ios::trunc);
+    if (!m_file.is_open())
+    {
+        cout << "Unable to open " << path << endl;
+        return -1;
+    }
+
+    m_file << "# clock latch: device_ticks=" << latch.deviceTicks << " host_monotonic_ns=" << latch.hostNs
+           << " tick_frequency=" << latch.tickFrequency << "\n";
+    m_file << "frame_id,device_timestamp,host_monotonic_ns,exposure_us,gain_db,sharpness,file\n";
+    return 0;
+}
+
+void FrameLog::Append(const FrameMetadata& meta, const char* file)
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (!m_file.is_open())
+    {
+        return;
+    }
+    m_file << meta.frameId << "," << meta.deviceTimestamp << "," << meta.hostMonotonicNs << "," << meta.exposureTime
+           << "," << meta.gain << "," << meta.sharpness << "," << file << "\n";
+}
+
+void FrameLog::Close()
+{
+    lock_guard<mutex> lock(m_mutex);
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+}
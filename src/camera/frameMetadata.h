@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include <stdint.h>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+// Per-frame acquisition data, taken from chunk data when the camera provides it
+struct FrameMetadata
+{
+    FrameMetadata();
+
+    bool hasChunk;
+    int64_t frameId;
+    int64_t deviceTimestamp; // device clock ticks at start of exposure
+    int64_t hostMonotonicNs; // deviceTimestamp mapped onto the host monotonic clock
+    double exposureTime;     // microseconds
+    double gain;             // dB
+    double sharpness;        // variance of Laplacian, -1 when not scored
+};
+
+// One simultaneous reading of the device clock and the host monotonic clock,
+// used to put chunk timestamps on the host timeline
+struct ClockLatch
+{
+    ClockLatch();
+
+    bool valid;
+    int64_t deviceTicks;
+    int64_t hostNs;
+    double tickFrequency; // device ticks per second
+};
+
+// Host monotonic time in nanoseconds. steady_clock is CLOCK_MONOTONIC on Linux.
+int64_t HostMonotonicNs();
+
+// Enables ChunkModeActive plus the Timestamp, FrameID, ExposureTime and Gain
+// chunks, following the ChunkData sample's ConfigureChunkData
+int ConfigureChunkData(Spinnaker::GenApi::INodeMap& nodeMap);
+
+// Latches the device timestamp and pairs it with the host clock
+int LatchDeviceClock(Spinnaker::GenApi::INodeMap& nodeMap, ClockLatch& latch);
+
+// Fills meta from the image's chunk data; leaves hasChunk false if there is none
+void ReadFrameMetadata(const Spinnaker::ImagePtr& image, const ClockLatch& latch, FrameMetadata& meta);
+
+// CSV record of every saved frame so downstream tools do not have to recover
+// timing from file names
+class FrameLog
+{
+public:
+    int Open(const std::string& path, const ClockLatch& latch);
+    void Append(const FrameMetadata& meta, const char* file);
+    void Close();
+
+private:
+    std::ofstream m_file;
+    std::mutex m_mutex;
+};
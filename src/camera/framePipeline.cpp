@@ -0,0 +1,394 @@
+#include "framePipeline.h"
+#include <limits.h>
+#include <iostream>
+#include <stdio.h>
+using namespace Spinnaker;
+using namespace std;
+
+// snprintf result check for frame paths: a name that does not fit fails its
+// frame rather than being cut to a path every later frame overwrites too
+static bool LocationFits(int length, char* location, size_t size)
+{
+    if (length >= 0 && (size_t)length < size)
+    {
+        return true;
+    }
+    snprintf(location, size, "(path too long)");
+    return false;
+}
+
+FramePipeline::FramePipeline(const CaptureConfig& config, FrameLog* frameLog, CaptureWriter* captureWriter,
+                             CaptureTelemetry* telemetry)
+    : m_config(config),
+      m_frameLog(frameLog),
+      m_captureWriter(captureWriter),
+      m_telemetry(telemetry),
+      m_flatField(nullptr),
+      m_queue(config.queueCapacity),
+      m_queueHead(0),
+      m_queueCount(0),
+      m_finishing(false),
+      m_conversionWidth(0),
+      m_conversionHeight(0),
+      m_frameWidth(0),
+      m_frameHeight(0)
+{
+    m_stats.submitted = 0;
+    m_stats.dropped = 0;
+    m_stats.written = 0;
+    m_stats.failed = 0;
+    m_stats.fastPath = 0;
+    m_stats.compressed = 0;
+    m_stats.blurry = 0;
+    m_stats.maxDepth = 0;
+}
+
+FramePipeline::~FramePipeline()
+{
+    Finish();
+}
+
+int FramePipeline::PrepareConversionBuffers(size_t width, size_t height, bool hugePages)
+{
+    // Mono8 output is one byte per pixel
+    if (m_conversionBuffers.Allocate(m_config.numWorkers, width * height, hugePages) != 0)
+    {
+        return -1;
+    }
+    m_conversionWidth = width;
+    m_conversionHeight = height;
+    return 0;
+}
+
+void FramePipeline::SetFrameSize(size_t width, size_t height)
+{
+    m_frameWidth = width;
+    m_frameHeight = height;
+}
+
+void FramePipeline::SetFlatField(const FlatFieldCorrection* flatField)
+{
+    m_flatField = flatField;
+}
+
+void FramePipeline::Start()
+{
+    m_finishing = false;
+    for (unsigned int i = 0; i < m_config.numWorkers; i++)
+    {
+        m_workers.push_back(thread(&FramePipeline::WorkerLoop, this, i));
+    }
+    cout << "Started " << m_config.numWorkers << " worker threads, queue capacity " << m_config.queueCapacity
+         << endl;
+}
+
+bool FramePipeline::Submit(FrameJob& job)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    if (m_queueCount >= m_queue.size())
+    {
+        if (m_config.backpressure == BACKPRESSURE_DROP_NEWEST)
+        {
+            m_stats.dropped++;
+            lock.unlock();
+            ReleaseFrame(job.image, job.streamBuffer);
+            return false;
+        }
+        m_notFull.wait(lock, [this] { return m_queueCount < m_queue.size(); });
+    }
+
+    m_queue[(m_queueHead + m_queueCount) % m_queue.size()] = job;
+    m_queueCount++;
+    m_stats.submitted++;
+    if (m_telemetry != nullptr)
+    {
+        // only the grab thread submits, so it is the histogram's single writer
+        m_telemetry->RecordQueueDepth(m_queueCount);
+    }
+    if (m_queueCount > m_stats.maxDepth)
+    {
+        m_stats.maxDepth = m_queueCount;
+    }
+    lock.unlock();
+    m_notEmpty.notify_one();
+    return true;
+}
+
+void FramePipeline::Finish()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_finishing = true;
+    }
+    m_notEmpty.notify_all();
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        if (m_workers[i].joinable())
+        {
+            m_workers[i].join();
+        }
+    }
+    m_workers.clear();
+}
+
+PipelineStats FramePipeline::GetStats()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void FramePipeline::WorkerLoop(unsigned int workerId)
+{
+    // ImageProcessor is not shared between threads; each worker keeps its own
+    ImageProcessor processor;
+    processor.SetColorProcessing(SPINNAKER_COLOR_PROCESSING_ALGORITHM_HQ_LINEAR);
+
+    // Compressed frames are decompressed inside Convert. By default Spinnaker
+    // uses cores - 1 threads per call, which oversubscribes once several
+    // workers decompress at the same time, so split the cores between workers.
+    unsigned int decompressionThreads = m_config.decompressionThreads;
+    if (decompressionThreads == 0)
+    {
+        decompressionThreads = thread::hardware_concurrency() / m_config.numWorkers;
+        if (decompressionThreads == 0)
+        {
+            decompressionThreads = 1;
+        }
+    }
+    processor.SetNumDecompressionThreads(decompressionThreads);
+
+    ImagePtr convertTarget;
+    if (m_conversionBuffers.GetCount() > workerId)
+    {
+        convertTarget = Image::Create(m_conversionWidth, m_conversionHeight, 0, 0, OUTPUT_PIXEL_FORMAT,
+                                      m_conversionBuffers.GetBuffer(workerId));
+    }
+
+    // one encoder per worker, reused for every frame this worker saves
+    JpegEncoder encoder;
+    if (m_config.output == OUTPUT_JPEG && encoder.Init(m_config.jpegQuality, m_config.jpegRestartRows) == 0 &&
+        m_frameWidth > 0)
+    {
+        encoder.Reserve(m_frameWidth, m_frameHeight);
+    }
+    SharpnessScorer scorer;
+    scorer.Init(m_config.sharpnessDecimation);
+    scorer.Reserve(m_frameWidth, m_frameHeight);
+
+    while (true)
+    {
+        FrameJob job;
+        {
+            unique_lock<mutex> lock(m_mutex);
+            m_notEmpty.wait(lock, [this] { return m_queueCount > 0 || m_finishing; });
+            if (m_queueCount == 0)
+            {
+                // finishing and fully drained
+                return;
+            }
+            // swap so the slot stops referencing the image
+            swap(job, m_queue[m_queueHead]);
+            m_queueHead = (m_queueHead + 1) % m_queue.size();
+            m_queueCount--;
+        }
+        m_notFull.notify_one();
+        const int64_t dequeuedNs = HostMonotonicNs();
+
+        FrameOutcome outcome;
+        outcome.fastPath = false;
+        outcome.compressed = false;
+        outcome.rejected = false;
+        outcome.convertedNs = 0;
+        outcome.encodedNs = 0;
+        outcome.writtenNs = 0;
+        const bool ok = ProcessFrame(job, processor, convertTarget, encoder, scorer, outcome);
+
+        if (m_telemetry != nullptr && ok && !outcome.rejected)
+        {
+            // slot 0 is the grab thread
+            const unsigned int slot = workerId + 1;
+            m_telemetry->RecordLatency(slot, LATENCY_GRAB_TO_DEQUEUE, job.grabNs, dequeuedNs);
+            m_telemetry->RecordLatency(slot, LATENCY_DEQUEUE_TO_CONVERTED, dequeuedNs, outcome.convertedNs);
+            if (outcome.encodedNs != 0)
+            {
+                m_telemetry->RecordLatency(slot, LATENCY_CONVERTED_TO_ENCODED, outcome.convertedNs, outcome.encodedNs);
+                m_telemetry->RecordLatency(slot, LATENCY_ENCODED_TO_DISK, outcome.encodedNs, outcome.writtenNs);
+            }
+            else
+            {
+                m_telemetry->RecordLatency(slot, LATENCY_ENCODED_TO_DISK, outcome.convertedNs, outcome.writtenNs);
+            }
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        if (outcome.fastPath)
+        {
+            m_stats.fastPath++;
+        }
+        if (outcome.compressed)
+        {
+            m_stats.compressed++;
+        }
+        if (outcome.rejected)
+        {
+            m_stats.blurry++;
+        }
+        else if (ok)
+        {
+            m_stats.written++;
+        }
+        else
+        {
+            m_stats.failed++;
+        }
+    }
+}
+
+bool FramePipeline::ProcessFrame(FrameJob& job, ImageProcessor& processor, ImagePtr& convertTarget,
+                                 JpegEncoder& encoder, SharpnessScorer& scorer, FrameOutcome& outcome)
+{
+    bool ok = true;
+    bool released = false;
+    try
+    {
+        // Mono sensors already deliver the output format; encode straight from
+        // the driver buffer instead of paying for Convert's allocation and copy.
+        // The stream buffer is then held until the save completes. Compressed
+        // frames report Mono8 too but must go through Convert to be decoded,
+        // unless we were asked to store the compressed payload as-is.
+        ImagePtr outputImage = job.image;
+        outcome.compressed = job.image->IsCompressed();
+        const bool keepCompressed = outcome.compressed && m_config.storeCompressed;
+        // Correction works in place, which is only safe on a buffer this
+        // frame owns: replayed frames share their pixels, so they are copied
+        // through Convert first. Compressed frames that are decoded are
+        // corrected after Convert like any other; only a payload kept as-is
+        // is left alone.
+        const bool correct = m_flatField != nullptr && !keepCompressed;
+        const bool fastPath =
+            keepCompressed || (!outcome.compressed && job.image->GetPixelFormat() == OUTPUT_PIXEL_FORMAT &&
+                               (job.streamBuffer || !correct));
+        outcome.fastPath = fastPath;
+
+        // 16-bit frames are corrected at full depth before being reduced
+        bool corrected = false;
+        if (correct && !outcome.compressed && job.streamBuffer && job.image->GetPixelFormat() == PixelFormat_Mono16)
+        {
+            m_flatField->Apply16(static_cast<uint16_t*>(job.image->GetData()), job.image->GetWidth(),
+                                 job.image->GetHeight(), job.image->GetStride());
+            corrected = true;
+        }
+        if (!fastPath)
+        {
+            if (convertTarget != nullptr && job.image->GetWidth() == m_conversionWidth &&
+                job.image->GetHeight() == m_conversionHeight)
+            {
+                processor.Convert(job.image, convertTarget, OUTPUT_PIXEL_FORMAT);
+                outputImage = convertTarget;
+            }
+            else
+            {
+                outputImage = processor.Convert(job.image, OUTPUT_PIXEL_FORMAT);
+            }
+
+            // the driver buffer can go back to the stream as soon as we have our copy
+            ReleaseFrame(job.image, job.streamBuffer);
+            released = true;
+        }
+        if (correct && !corrected)
+        {
+            m_flatField->Apply8(static_cast<uint8_t*>(outputImage->GetData()), outputImage->GetWidth(),
+                                outputImage->GetHeight(), outputImage->GetStride());
+        }
+        outcome.convertedNs = HostMonotonicNs();
+
+        // score after correction so vignetting does not count as blur, and
+        // before encoding so rejected frames cost nothing more
+        if (m_config.sharpness && !keepCompressed)
+        {
+            job.meta.sharpness = scorer.Score(static_cast<const uint8_t*>(outputImage->GetData()),
+                                              outputImage->GetWidth(), outputImage->GetHeight(),
+                                              outputImage->GetStride());
+            if (m_config.minSharpness > 0 && job.meta.sharpness < m_config.minSharpness)
+            {
+                outcome.rejected = true;
+                if (!released)
+                {
+                    ReleaseFrame(job.image, job.streamBuffer);
+                }
+                lock_guard<mutex> lock(m_printMutex);
+                cout << "Image " << job.grabIndex << " dropped as blurry (sharpness " << job.meta.sharpness << ")"
+                     << endl;
+                return true;
+            }
+        }
+
+        // fixed buffer rather than a stream so naming a frame does not allocate
+        char location[PATH_MAX];
+        if (m_captureWriter != nullptr)
+        {
+            // raw pixels into the container, no per-frame file or encode
+            const int64_t offset = m_captureWriter->Append(outputImage->GetData(), outputImage->GetImageSize(), job.meta,
+                                                           (uint32_t)outputImage->GetPixelFormat(),
+                                                           (uint32_t)outputImage->GetWidth(),
+                                                           (uint32_t)outputImage->GetHeight(),
+                                                           keepCompressed ? SPINNAKER_TLPAYLOAD_TYPE_LOSSLESS_COMPRESSED : 0);
+            outcome.writtenNs = HostMonotonicNs();
+            ok = LocationFits(snprintf(location, sizeof(location), "%s.ssd:%lld", m_config.captureName.c_str(),
+                                       (long long)offset),
+                              location, sizeof(location)) &&
+                 offset >= 0;
+        }
+        else if (keepCompressed)
+        {
+            // only the raw format keeps the payload compressed; decode at stitch time
+            ok = LocationFits(snprintf(location, sizeof(location), "%s-%g.raw", m_config.filePrefix.c_str(), job.hostTime),
+                              location, sizeof(location));
+            if (ok)
+            {
+                outputImage->Save(location, SPINNAKER_IMAGE_FILE_FORMAT_RAW);
+            }
+            outcome.writtenNs = HostMonotonicNs();
+        }
+        else
+        {
+            ok = LocationFits(snprintf(location, sizeof(location), "%s-%g.jpg", m_config.filePrefix.c_str(), job.hostTime),
+                              location, sizeof(location));
+
+            // Encode with this worker's libjpeg-turbo instance into its
+            // preallocated buffer, then write the file in one go
+            ok = ok && encoder.Encode(static_cast<const uint8_t*>(outputImage->GetData()), outputImage->GetWidth(),
+                                      outputImage->GetHeight(), outputImage->GetStride()) == 0;
+            outcome.encodedNs = HostMonotonicNs();
+            ok = ok && encoder.WriteFile(location) == 0;
+            outcome.writtenNs = HostMonotonicNs();
+        }
+
+        if (fastPath)
+        {
+            ReleaseFrame(job.image, job.streamBuffer);
+            released = true;
+        }
+
+        if (ok && m_frameLog != nullptr)
+        {
+            m_frameLog->Append(job.meta, location);
+        }
+
+        lock_guard<mutex> lock(m_printMutex);
+        cout << "Image " << job.grabIndex << (ok ? " saved at " : " failed to save at ") << location << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        lock_guard<mutex> lock(m_printMutex);
+        cout << "Error processing image " << job.grabIndex << ": " << e.what() << endl;
+        ok = false;
+        if (!released)
+        {
+            ReleaseFrame(job.image, job.streamBuffer);
+        }
+    }
+    return ok;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include "bufferPool.h"
+#include "captureConfig.h"
+#include "captureFile.h"
+#include "flatField.h"
+#include "frameMetadata.h"
+#include "frameSource.h"
+#include "jpegEncoder.h"
+#include "sharpness.h"
+#include "telemetry.h"
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Pixel format written to disk
+#define OUTPUT_PIXEL_FORMAT Spinnaker::PixelFormat_Mono8
+
+// A frame handed from the grab thread to the worker pool. The worker owns the
+// image from then on and is responsible for releasing it back to the stream.
+struct FrameJob
+{
+    Spinnaker::ImagePtr image;
+    bool streamBuffer; // see ReleaseFrame
+    uint64_t grabIndex;
+    int64_t grabNs;  // host monotonic time GetNextImage returned
+    double hostTime; // seconds since acquisition start, used in the file name
+    FrameMetadata meta;
+};
+
+struct PipelineStats
+{
+    uint64_t submitted;
+    uint64_t dropped;
+    uint64_t written;
+    uint64_t failed;
+    uint64_t fastPath;   // frames saved without conversion
+    uint64_t compressed; // frames that arrived compressed from the camera
+    uint64_t blurry;     // frames dropped under --min-sharpness
+    size_t maxDepth;
+};
+
+// Bounded queue between GetNextImage and a pool of worker threads that convert,
+// encode and write frames, so a slow save never holds up the next grab.
+class FramePipeline
+{
+public:
+    // frameLog may be null; otherwise every saved frame is appended to it.
+    // With a captureWriter frames go into the container instead of JPEG files.
+    // telemetry may be null; otherwise stage latencies and queue depth go to it.
+    FramePipeline(const CaptureConfig& config, FrameLog* frameLog, CaptureWriter* captureWriter,
+                  CaptureTelemetry* telemetry);
+    ~FramePipeline();
+
+    // Gives each worker a fixed conversion target of width x height in the
+    // output format, so Convert writes into reused memory instead of a fresh
+    // image per frame. Call before Start.
+    int PrepareConversionBuffers(size_t width, size_t height, bool hugePages);
+
+    // Frame size the camera will deliver, so each worker's JPEG encoder can
+    // size its output buffer up front. Call before Start.
+    void SetFrameSize(size_t width, size_t height);
+
+    // Dark/flat correction applied to every uncompressed frame before it is
+    // encoded or stored; null (the default) for none. Call before Start.
+    void SetFlatField(const FlatFieldCorrection* flatField);
+
+    void Start();
+
+    // Called from the grab thread. Returns false if the frame was dropped
+    // because the queue was full and the policy is BACKPRESSURE_DROP_NEWEST.
+    bool Submit(FrameJob& job);
+
+    // Processes everything still queued and joins the workers.
+    void Finish();
+
+    PipelineStats GetStats();
+
+private:
+    struct FrameOutcome
+    {
+        bool fastPath;
+        bool compressed;
+        bool rejected; // scored below --min-sharpness and not written
+        // host monotonic stage times; 0 when a stage does not apply
+        int64_t convertedNs;
+        int64_t encodedNs;
+        int64_t writtenNs;
+    };
+
+    void WorkerLoop(unsigned int workerId);
+    bool ProcessFrame(FrameJob& job, Spinnaker::ImageProcessor& processor, Spinnaker::ImagePtr& convertTarget,
+                      JpegEncoder& encoder, SharpnessScorer& scorer, FrameOutcome& outcome);
+
+    const CaptureConfig& m_config;
+    FrameLog* m_frameLog;
+    CaptureWriter* m_captureWriter;
+    CaptureTelemetry* m_telemetry;
+    const FlatFieldCorrection* m_flatField;
+    // fixed ring of queueCapacity slots so queueing never allocates
+    std::vector<FrameJob> m_queue;
+    size_t m_queueHead;
+    size_t m_queueCount;
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::vector<std::thread> m_workers;
+    bool m_finishing;
+
+    BufferPool m_conversionBuffers;
+    size_t m_conversionWidth;
+    size_t m_conversionHeight;
+    size_t m_frameWidth;
+    size_t m_frameHeight;
+
+    PipelineStats m_stats;
+    std::mutex m_printMutex;
+};
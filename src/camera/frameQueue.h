@@ -0,0 +1,272 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+// Lock-free bounded rings for handing frames between threads without ever
+// blocking the producer. Items are moved in and out, so they can carry
+// ImagePtr, buffer indices or any other move-only handle. Capacities are
+// rounded up to a power of two. A full ring makes TryPush return false and
+// leaves the item with the caller, who decides whether to drop, retry or wait.
+
+#define FRAME_QUEUE_CACHE_LINE 64
+
+// Fixed array of cache-line aligned elements; std::vector does not honour
+// over-aligned types before C++17
+template <typename T>
+class CacheAlignedArray
+{
+public:
+    explicit CacheAlignedArray(size_t count)
+        : m_data(nullptr),
+          m_count(count)
+    {
+        void* memory = nullptr;
+        if (posix_memalign(&memory, FRAME_QUEUE_CACHE_LINE, count * sizeof(T)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        m_data = static_cast<T*>(memory);
+        for (size_t i = 0; i < count; i++)
+        {
+            new (&m_data[i]) T();
+        }
+    }
+
+    ~CacheAlignedArray()
+    {
+        for (size_t i = 0; i < m_count; i++)
+        {
+            m_data[i].~T();
+        }
+        free(m_data);
+    }
+
+    T& operator[](size_t i) { return m_data[i]; }
+    const T& operator[](size_t i) const { return m_data[i]; }
+    size_t size() const { return m_count; }
+
+private:
+    CacheAlignedArray(const CacheAlignedArray&);
+    CacheAlignedArray& operator=(const CacheAlignedArray&);
+
+    T* m_data;
+    size_t m_count;
+};
+
+inline size_t FrameQueueCapacity(size_t requested)
+{
+    size_t capacity = 2;
+    while (capacity < requested)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+// One producer thread, one consumer thread. Each side keeps a cached copy of
+// the other's index so the shared cache line is only read when the ring looks
+// full (producer) or empty (consumer).
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity)
+        : m_slots(FrameQueueCapacity(capacity)),
+          m_mask(m_slots.size() - 1)
+    {
+        m_head.value.store(0, std::memory_order_relaxed);
+        m_tail.value.store(0, std::memory_order_relaxed);
+        m_producer.cachedHead = 0;
+        m_consumer.cachedTail = 0;
+    }
+
+    // Producer only
+    bool TryPush(T&& item)
+    {
+        const size_t tail = m_tail.value.load(std::memory_order_relaxed);
+        if (tail - m_producer.cachedHead > m_mask)
+        {
+            m_producer.cachedHead = m_head.value.load(std::memory_order_acquire);
+            if (tail - m_producer.cachedHead > m_mask)
+            {
+                return false;
+            }
+        }
+        m_slots[tail & m_mask].item = std::move(item);
+        m_tail.value.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    bool TryPop(T& item)
+    {
+        const size_t head = m_head.value.load(std::memory_order_relaxed);
+        if (head == m_consumer.cachedTail)
+        {
+            m_consumer.cachedTail = m_tail.value.load(std::memory_order_acquire);
+            if (head == m_consumer.cachedTail)
+            {
+                return false;
+            }
+        }
+        Slot& slot = m_slots[head & m_mask];
+        item = std::move(slot.item);
+        // drop whatever the moved-from slot still references
+        slot.item = T();
+        m_head.value.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Exact only when called from one of the two sides while the other is idle
+    size_t SizeApprox() const
+    {
+        return m_tail.value.load(std::memory_order_acquire) - m_head.value.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const { return m_slots.size(); }
+
+private:
+    SpscRing(const SpscRing&);
+    SpscRing& operator=(const SpscRing&);
+
+    struct alignas(FRAME_QUEUE_CACHE_LINE) Slot
+    {
+        T item;
+    };
+    struct alignas(FRAME_QUEUE_CACHE_LINE) Index
+    {
+        std::atomic<size_t> value;
+    };
+    struct alignas(FRAME_QUEUE_CACHE_LINE) ProducerCache
+    {
+        size_t cachedHead;
+    };
+    struct alignas(FRAME_QUEUE_CACHE_LINE) ConsumerCache
+    {
+        size_t cachedTail;
+    };
+
+    CacheAlignedArray<Slot> m_slots;
+    const size_t m_mask;
+    Index m_head; // next slot to pop, written by the consumer
+    Index m_tail; // next slot to push, written by the producer
+    ProducerCache m_producer;
+    ConsumerCache m_consumer;
+};
+
+// Any number of producers and consumers, after Dmitry Vyukov's bounded MPMC
+// queue: every slot carries a sequence number telling whose turn it is, so a
+// push or pop is one CAS on the shared index plus one store to the slot.
+template <typename T>
+class MpmcRing
+{
+public:
+    explicit MpmcRing(size_t capacity)
+        : m_slots(FrameQueueCapacity(capacity)),
+          m_mask(m_slots.size() - 1)
+    {
+        for (size_t i = 0; i < m_slots.size(); i++)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        m_enqueue.value.store(0, std::memory_order_relaxed);
+        m_dequeue.value.store(0, std::memory_order_relaxed);
+    }
+
+    bool TryPush(T&& item)
+    {
+        size_t position = m_enqueue.value.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &m_slots[position & m_mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+            if (difference == 0)
+            {
+                if (m_enqueue.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                // the slot still holds an item from one lap ago
+                return false;
+            }
+            else
+            {
+                position = m_enqueue.value.load(std::memory_order_relaxed);
+            }
+        }
+        slot->item = std::move(item);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool TryPop(T& item)
+    {
+        size_t position = m_dequeue.value.load(std::memory_order_relaxed);
+        Slot* slot;
+        while (true)
+        {
+            slot = &m_slots[position & m_mask];
+            const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+            if (difference == 0)
+            {
+                if (m_dequeue.value.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_dequeue.value.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(slot->item);
+        slot->item = T();
+        // hand the slot to the producer one lap ahead
+        slot->sequence.store(position + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Racy snapshot, for telemetry
+    size_t SizeApprox() const
+    {
+        const size_t enqueued = m_enqueue.value.load(std::memory_order_relaxed);
+        const size_t dequeued = m_dequeue.value.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+    size_t Capacity() const { return m_slots.size(); }
+
+private:
+    MpmcRing(const MpmcRing&);
+    MpmcRing& operator=(const MpmcRing&);
+
+    struct alignas(FRAME_QUEUE_CACHE_LINE) Slot
+    {
+        std::atomic<size_t> sequence;
+        T item;
+    };
+    struct alignas(FRAME_QUEUE_CACHE_LINE) Index
+    {
+        std::atomic<size_t> value;
+    };
+
+    CacheAlignedArray<Slot> m_slots;
+    const size_t m_mask;
+    Index m_enqueue;
+    Index m_dequeue;
+};
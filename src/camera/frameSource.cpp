@@ -0,0 +1,336 @@
+#include "frameSource.h"
+#include "frameMetadata.h"
+#include "streamHealth.h"
+#include <dirent.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <jpeglib.h>
+#include <png.h>
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace Spinnaker::GenICam;
+using namespace std;
+
+FrameInfo::FrameInfo()
+    : frameId(-1),
+      incomplete(false),
+      imageStatus(0),
+      streamBuffer(true)
+{
+}
+
+void ReleaseFrame(const ImagePtr& image, bool streamBuffer)
+{
+    if (streamBuffer)
+    {
+        image->Release();
+    }
+}
+
+CameraFrameSource::CameraFrameSource(CameraPtr pCam)
+    : m_camera(pCam)
+{
+}
+
+int CameraFrameSource::PrepareStream(const CaptureConfig& config)
+{
+    if (config.userBuffers > 0 &&
+        ConfigureUserBuffers(m_camera, m_camera->GetNodeMap(), config.userBuffers, config.hugePages,
+                             m_userBuffers) != 0)
+    {
+        return -1;
+    }
+    return ConfigureStreamBuffers(m_camera, config);
+}
+
+bool CameraFrameSource::GetFrameSize(size_t& width, size_t& height)
+{
+    INodeMap& nodeMap = m_camera->GetNodeMap();
+    CIntegerPtr ptrWidth = nodeMap.GetNode("Width");
+    CIntegerPtr ptrHeight = nodeMap.GetNode("Height");
+    if (!IsReadable(ptrWidth) || !IsReadable(ptrHeight))
+    {
+        return false;
+    }
+    width = (size_t)ptrWidth->GetValue();
+    height = (size_t)ptrHeight->GetValue();
+    return true;
+}
+
+void CameraFrameSource::BeginAcquisition()
+{
+    m_camera->BeginAcquisition();
+}
+
+ImagePtr CameraFrameSource::GetNextImage(uint64_t grabTimeout, FrameInfo& info)
+{
+    ImagePtr image = m_camera->GetNextImage(grabTimeout);
+    info.frameId = (int64_t)image->GetFrameID();
+    info.incomplete = image->IsIncomplete();
+    info.imageStatus = (int)image->GetImageStatus();
+    info.streamBuffer = true;
+    return image;
+}
+
+void CameraFrameSource::EndAcquisition()
+{
+    m_camera->EndAcquisition();
+}
+
+void CameraFrameSource::ReadStreamCounters(int64_t& dropped, int64_t& lost)
+{
+    ::ReadStreamCounters(m_camera, dropped, lost);
+}
+
+int64_t CameraFrameSource::ReportStreamStatistics()
+{
+    return ::ReportStreamStatistics(m_camera);
+}
+
+// libjpeg's default error handler calls exit()
+struct JpegDecodeError
+{
+    jpeg_error_mgr manager;
+    jmp_buf jump;
+};
+
+static void OnJpegDecodeError(j_common_ptr cinfo)
+{
+    longjmp(reinterpret_cast<JpegDecodeError*>(cinfo->err)->jump, 1);
+}
+
+static int DecodeJpeg(const string& path, vector<uint8_t>& pixels, size_t& width, size_t& height)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return -1;
+    }
+
+    jpeg_decompress_struct cinfo;
+    JpegDecodeError error;
+    cinfo.err = jpeg_std_error(&error.manager);
+    error.manager.error_exit = OnJpegDecodeError;
+    if (setjmp(error.jump))
+    {
+        jpeg_destroy_decompress(&cinfo);
+        fclose(file);
+        return -1;
+    }
+
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_GRAYSCALE;
+    jpeg_start_decompress(&cinfo);
+
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    pixels.resize(width * height);
+    while (cinfo.output_scanline < cinfo.output_height)
+    {
+        JSAMPROW row = pixels.data() + (size_t)cinfo.output_scanline * width;
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(file);
+    return 0;
+}
+
+static int DecodePng(const string& path, vector<uint8_t>& pixels, size_t& width, size_t& height)
+{
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, path.c_str()))
+    {
+        return -1;
+    }
+
+    // libpng converts colour tiles to 8-bit gray for us
+    image.format = PNG_FORMAT_GRAY;
+    width = image.width;
+    height = image.height;
+    pixels.resize(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, nullptr, pixels.data(), 0, nullptr))
+    {
+        png_image_free(&image);
+        return -1;
+    }
+    return 0;
+}
+
+static bool HasExtension(const string& name, const char* extension)
+{
+    const size_t length = strlen(extension);
+    return name.size() > length && strcasecmp(name.c_str() + name.size() - length, extension) == 0;
+}
+
+ReplayFrameSource::ReplayFrameSource(const CaptureConfig& config)
+    : m_config(config),
+      m_random(config.replaySeed),
+      m_triggered(!config.triggerLine.empty()),
+      m_startNs(0),
+      m_sequence(0),
+      m_delivered(0),
+      m_dropped(0),
+      m_incomplete(0)
+{
+}
+
+int ReplayFrameSource::Load(const string& directory)
+{
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+    {
+        cout << "Unable to open replay directory " << directory << endl;
+        return -1;
+    }
+    vector<string> names;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
+    {
+        const string name = entry->d_name;
+        if (HasExtension(name, ".jpg") || HasExtension(name, ".jpeg") || HasExtension(name, ".png"))
+        {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    sort(names.begin(), names.end());
+
+    // decode everything now so replay speed is not limited by the decoder
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        const string path = directory + "/" + names[i];
+        ReplayFrame frame;
+        const int err = HasExtension(names[i], ".png") ? DecodePng(path, frame.pixels, frame.width, frame.height)
+                                                       : DecodeJpeg(path, frame.pixels, frame.width, frame.height);
+        if (err != 0)
+        {
+            cout << "Skipping " << path << ", unable to decode" << endl;
+            continue;
+        }
+        m_frames.push_back(frame);
+    }
+
+    if (m_frames.empty())
+    {
+        cout << "No replayable frames in " << directory << endl;
+        return -1;
+    }
+    cout << "Replaying " << m_frames.size() << " frames from " << directory << endl;
+
+    if (m_triggered && m_trigger.Open(STAGE_TRIGGER_GPIO) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int ReplayFrameSource::PrepareStream(const CaptureConfig& config)
+{
+    return 0;
+}
+
+bool ReplayFrameSource::GetFrameSize(size_t& width, size_t& height)
+{
+    if (m_frames.empty())
+    {
+        return false;
+    }
+    width = m_frames[0].width;
+    height = m_frames[0].height;
+    return true;
+}
+
+void ReplayFrameSource::BeginAcquisition()
+{
+    m_startNs = HostMonotonicNs();
+    m_sequence = 0;
+    m_trigger.Arm();
+}
+
+ImagePtr ReplayFrameSource::GetNextImage(uint64_t grabTimeout, FrameInfo& info)
+{
+    if (m_frames.empty())
+    {
+        throw Spinnaker::Exception(__LINE__, __FILE__, __FUNCTION__, "No replay frames loaded",
+                                   SPINNAKER_ERR_NOT_AVAILABLE);
+    }
+
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    while (true)
+    {
+        const uint64_t slot = m_sequence++;
+
+        if (m_triggered)
+        {
+            if (!m_trigger.WaitForEdge(grabTimeout))
+            {
+                m_sequence--;
+                throw Spinnaker::Exception(__LINE__, __FILE__, __FUNCTION__, "Timed out waiting for a trigger",
+                                           SPINNAKER_ERR_TIMEOUT);
+            }
+        }
+        // each frame is due one period after the last, give or take the jitter
+        else if (m_config.frameRate > 0)
+        {
+            const double jitterNs = (unit(m_random) * 2.0 - 1.0) * m_config.replayJitterUs * 1000.0;
+            const int64_t dueNs = m_startNs + (int64_t)((double)slot * 1000000000.0 / m_config.frameRate + jitterNs);
+            const int64_t waitNs = dueNs - HostMonotonicNs();
+            if (waitNs > 0)
+            {
+                this_thread::sleep_for(chrono::nanoseconds(waitNs));
+            }
+        }
+
+        // a dropped frame uses up its FrameID and its time slot
+        if (unit(m_random) < m_config.replayDropRate)
+        {
+            m_dropped++;
+            continue;
+        }
+
+        const ReplayFrame& frame = m_frames[slot % m_frames.size()];
+        info.frameId = (int64_t)slot;
+        info.incomplete = unit(m_random) < m_config.replayIncompleteRate;
+        info.imageStatus = info.incomplete ? SPINNAKER_IMAGE_STATUS_MISSING_PACKETS : SPINNAKER_IMAGE_STATUS_NO_ERROR;
+        info.streamBuffer = false;
+        if (info.incomplete)
+        {
+            m_incomplete++;
+        }
+        m_delivered++;
+
+        // wraps the decoded pixels; workers only ever read them
+        return Image::Create(frame.width, frame.height, 0, 0, PixelFormat_Mono8,
+                             const_cast<uint8_t*>(frame.pixels.data()));
+    }
+}
+
+void ReplayFrameSource::EndAcquisition()
+{
+}
+
+void ReplayFrameSource::ReadStreamCounters(int64_t& dropped, int64_t& lost)
+{
+    dropped = (int64_t)m_dropped;
+    lost = 0;
+}
+
+int64_t ReplayFrameSource::ReportStreamStatistics()
+{
+    cout << "Replay statistics:" << endl
+         << "\tdelivered: " << m_delivered << endl
+         << "\tdropped (injected): " << m_dropped << endl
+         << "\tincomplete (injected): " << m_incomplete << endl;
+    return (int64_t)m_dropped;
+}
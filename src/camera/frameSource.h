@@ -0,0 +1,115 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include "bufferPool.h"
+#include "captureConfig.h"
+#include "simTrigger.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <random>
+#include <string>
+#include <vector>
+
+// What the grab loop needs to know about a frame besides its pixels
+struct FrameInfo
+{
+    FrameInfo();
+
+    int64_t frameId;
+    bool incomplete;
+    int imageStatus;   // Spinnaker ImageStatus, for incomplete frames
+    bool streamBuffer; // image belongs to a stream and must be Release()d
+};
+
+// Gives a frame back to where it came from. Stream images go back to the
+// driver; replayed images just drop their reference.
+void ReleaseFrame(const Spinnaker::ImagePtr& image, bool streamBuffer);
+
+// Where the acquisition loop gets its frames: a real camera, or recorded frames
+// replayed so the pipeline can be run and benchmarked without hardware.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    // Stream settings that must be applied before BeginAcquisition
+    virtual int PrepareStream(const CaptureConfig& config) = 0;
+
+    // Size of the frames about to be delivered; false if unknown
+    virtual bool GetFrameSize(size_t& width, size_t& height) = 0;
+
+    virtual void BeginAcquisition() = 0;
+
+    // Throws Spinnaker::Exception on timeout, like CameraBase::GetNextImage
+    virtual Spinnaker::ImagePtr GetNextImage(uint64_t grabTimeout, FrameInfo& info) = 0;
+
+    virtual void EndAcquisition() = 0;
+
+    // Frames the source knows were dropped or lost; -1 where not available
+    virtual void ReadStreamCounters(int64_t& dropped, int64_t& lost) = 0;
+
+    // Prints the source's counters and returns dropped + lost, or -1
+    virtual int64_t ReportStreamStatistics() = 0;
+};
+
+// Frames from an initialized Spinnaker camera
+class CameraFrameSource : public FrameSource
+{
+public:
+    explicit CameraFrameSource(Spinnaker::CameraPtr pCam);
+
+    int PrepareStream(const CaptureConfig& config) override;
+    bool GetFrameSize(size_t& width, size_t& height) override;
+    void BeginAcquisition() override;
+    Spinnaker::ImagePtr GetNextImage(uint64_t grabTimeout, FrameInfo& info) override;
+    void EndAcquisition() override;
+    void ReadStreamCounters(int64_t& dropped, int64_t& lost) override;
+    int64_t ReportStreamStatistics() override;
+
+private:
+    Spinnaker::CameraPtr m_camera;
+    // user stream buffers; a member so they outlive EndAcquisition
+    BufferPool m_userBuffers;
+};
+
+// Replays JPEG/PNG files from a directory as Mono8 frames, decoded up front.
+// Frames are paced at --frame-rate (unpaced when 0) with optional timing
+// jitter, dropped frames (FrameID gaps) and incomplete frames, drawn from a
+// seeded generator so a run can be repeated exactly. With --trigger set, a
+// frame is delivered per rising edge of the simulated stage trigger pin instead.
+class ReplayFrameSource : public FrameSource
+{
+public:
+    explicit ReplayFrameSource(const CaptureConfig& config);
+
+    // Loads every .jpg/.jpeg/.png in directory, in name order
+    int Load(const std::string& directory);
+
+    int PrepareStream(const CaptureConfig& config) override;
+    bool GetFrameSize(size_t& width, size_t& height) override;
+    void BeginAcquisition() override;
+    Spinnaker::ImagePtr GetNextImage(uint64_t grabTimeout, FrameInfo& info) override;
+    void EndAcquisition() override;
+    void ReadStreamCounters(int64_t& dropped, int64_t& lost) override;
+    int64_t ReportStreamStatistics() override;
+
+private:
+    struct ReplayFrame
+    {
+        std::vector<uint8_t> pixels;
+        size_t width;
+        size_t height;
+    };
+
+    const CaptureConfig& m_config;
+    std::vector<ReplayFrame> m_frames;
+    std::mt19937 m_random;
+    SimTriggerLine m_trigger;
+    bool m_triggered;
+    int64_t m_startNs;
+    uint64_t m_sequence; // frame slots elapsed, including dropped ones
+    uint64_t m_delivered;
+    uint64_t m_dropped;
+    uint64_t m_incomplete;
+};
@@ -0,0 +1,180 @@
+#include "jpegEncoder.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <jpeglib.h>
+using namespace std;
+
+struct JpegEncoderContext
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr errorManager;
+    jpeg_destination_mgr destination;
+    jmp_buf errorJump;
+    char errorMessage[JMSG_LENGTH_MAX];
+    vector<uint8_t>* output;
+};
+
+// libjpeg's default error handler calls exit(); jump back into Encode instead
+static void OnJpegError(j_common_ptr cinfo)
+{
+    JpegEncoderContext* context = reinterpret_cast<JpegEncoderContext*>(cinfo->client_data);
+    (*cinfo->err->format_message)(cinfo, context->errorMessage);
+    longjmp(context->errorJump, 1);
+}
+
+static void OnInitDestination(j_compress_ptr cinfo)
+{
+    JpegEncoderContext* context = reinterpret_cast<JpegEncoderContext*>(cinfo->client_data);
+    cinfo->dest->next_output_byte = context->output->data();
+    cinfo->dest->free_in_buffer = context->output->size();
+}
+
+// Only reached if Reserve was not called or the bound was wrong
+static boolean OnEmptyOutputBuffer(j_compress_ptr cinfo)
+{
+    JpegEncoderContext* context = reinterpret_cast<JpegEncoderContext*>(cinfo->client_data);
+    const size_t used = context->output->size();
+    context->output->resize(used > 0 ? used * 2 : 65536);
+    cinfo->dest->next_output_byte = context->output->data() + used;
+    cinfo->dest->free_in_buffer = context->output->size() - used;
+    return TRUE;
+}
+
+static void OnTermDestination(j_compress_ptr cinfo)
+{
+}
+
+size_t JpegBufferSize(size_t width, size_t height)
+{
+    // same bound as tjBufSize for one component: MCU padded, 2 bytes per
+    // pixel worst case, plus room for headers and tables
+    const size_t paddedWidth = (width + 7) & ~(size_t)7;
+    const size_t paddedHeight = (height + 7) & ~(size_t)7;
+    return paddedWidth * paddedHeight * 2 + 2048;
+}
+
+JpegEncoder::JpegEncoder()
+    : m_context(nullptr),
+      m_size(0),
+      m_quality(90),
+      m_restartRows(0)
+{
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    if (m_context != nullptr)
+    {
+        jpeg_destroy_compress(&m_context->cinfo);
+        delete m_context;
+    }
+}
+
+int JpegEncoder::Init(int quality, unsigned int restartRows)
+{
+    if (m_context == nullptr)
+    {
+        m_context = new JpegEncoderContext();
+        m_context->output = &m_output;
+        m_context->cinfo.err = jpeg_std_error(&m_context->errorManager);
+        m_context->errorManager.error_exit = OnJpegError;
+        m_context->cinfo.client_data = m_context;
+        if (setjmp(m_context->errorJump))
+        {
+            cout << "Unable to create JPEG encoder: " << m_context->errorMessage << endl;
+            delete m_context;
+            m_context = nullptr;
+            return -1;
+        }
+        jpeg_create_compress(&m_context->cinfo);
+
+        m_context->destination.init_destination = OnInitDestination;
+        m_context->destination.empty_output_buffer = OnEmptyOutputBuffer;
+        m_context->destination.term_destination = OnTermDestination;
+        m_context->cinfo.dest = &m_context->destination;
+    }
+    m_quality = quality;
+    m_restartRows = restartRows;
+    return 0;
+}
+
+void JpegEncoder::Reserve(size_t width, size_t height)
+{
+    const size_t bound = JpegBufferSize(width, height);
+    if (m_output.size() < bound)
+    {
+        m_output.resize(bound);
+    }
+}
+
+int JpegEncoder::Encode(const uint8_t* pixels, size_t width, size_t height, size_t stride)
+{
+    if (m_context == nullptr)
+    {
+        return -1;
+    }
+    Reserve(width, height);
+
+    jpeg_compress_struct* cinfo = &m_context->cinfo;
+    if (setjmp(m_context->errorJump))
+    {
+        cout << "JPEG encode failed: " << m_context->errorMessage << endl;
+        jpeg_abort_compress(cinfo);
+        m_size = 0;
+        return -1;
+    }
+
+    cinfo->image_width = (JDIMENSION)width;
+    cinfo->image_height = (JDIMENSION)height;
+    cinfo->input_components = 1;
+    cinfo->in_color_space = JCS_GRAYSCALE;
+    jpeg_set_defaults(cinfo);
+    jpeg_set_quality(cinfo, m_quality, TRUE);
+    cinfo->restart_in_rows = (int)m_restartRows;
+    // accurate integer DCT; libjpeg-turbo has SIMD versions of it
+    cinfo->dct_method = JDCT_ISLOW;
+
+    jpeg_start_compress(cinfo, TRUE);
+    while (cinfo->next_scanline < cinfo->image_height)
+    {
+        JSAMPROW row = const_cast<JSAMPROW>(pixels + (size_t)cinfo->next_scanline * stride);
+        jpeg_write_scanlines(cinfo, &row, 1);
+    }
+    jpeg_finish_compress(cinfo);
+
+    m_size = m_output.size() - cinfo->dest->free_in_buffer;
+    return 0;
+}
+
+int JpegEncoder::WriteFile(const char* path) const
+{
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        cout << "Unable to create " << path << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    size_t written = 0;
+    while (written < m_size)
+    {
+        const ssize_t n = write(fd, m_output.data() + written, m_size - written);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            cout << "Error writing " << path << ": " << strerror(errno) << endl;
+            close(fd);
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    return close(fd) == 0 ? 0 : -1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// libjpeg state lives in jpegEncoder.cpp so jpeglib.h stays out of the
+// Spinnaker translation units
+struct JpegEncoderContext;
+
+// Grayscale JPEG encoder on libjpeg(-turbo), used instead of Image::Save so
+// quality and restart markers can be set and the output lands in a buffer we
+// own. One instance per worker thread; it is reused for every frame and keeps
+// its compressor and output buffer between frames.
+class JpegEncoder
+{
+public:
+    JpegEncoder();
+    ~JpegEncoder();
+
+    // quality is 1-100; restartRows puts a restart marker every N MCU rows
+    // (0 for none) so a corrupted block only loses a stripe of the frame
+    int Init(int quality, unsigned int restartRows);
+
+    // Sizes the output buffer for the worst case of a width x height frame so
+    // encoding never has to grow it
+    void Reserve(size_t width, size_t height);
+
+    // Encodes 8-bit single channel pixels, stride bytes per row
+    int Encode(const uint8_t* pixels, size_t width, size_t height, size_t stride);
+
+    // Writes the last encoded frame to path
+    int WriteFile(const char* path) const;
+
+    const uint8_t* GetData() const { return m_output.data(); }
+    size_t GetSize() const { return m_size; }
+
+private:
+    JpegEncoder(const JpegEncoder&);
+    JpegEncoder& operator=(const JpegEncoder&);
+
+    JpegEncoderContext* m_context;
+    std::vector<uint8_t> m_output;
+    size_t m_size;
+    int m_quality;
+    unsigned int m_restartRows;
+};
+
+// Upper bound on the encoded size of a width x height grayscale frame
+size_t JpegBufferSize(size_t width, size_t height);
@@ -0,0 +1,256 @@
+#include "motionSelector.h"
+#include <math.h>
+#include <algorithm>
+using namespace std;
+
+// Normalised correlation peak below which a shift is treated as noise; a
+// random-phase surface of MOTION_WINDOW^2 samples peaks around 0.03
+#define MOTION_MIN_PEAK 0.06
+
+typedef complex<float> Complex;
+
+// In-place iterative radix-2 FFT of n (a power of two) samples; the inverse is
+// left unscaled
+static void Fft(Complex* data, size_t n, bool inverse)
+{
+    for (size_t i = 1, j = 0; i < n; i++)
+    {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            swap(data[i], data[j]);
+        }
+    }
+    for (size_t length = 2; length <= n; length <<= 1)
+    {
+        const double angle = (inverse ? 2.0 : -2.0) * M_PI / (double)length;
+        const Complex rotation((float)cos(angle), (float)sin(angle));
+        for (size_t start = 0; start < n; start += length)
+        {
+            Complex twiddle(1.0f, 0.0f);
+            for (size_t k = 0; k < length / 2; k++)
+            {
+                const Complex even = data[start + k];
+                const Complex odd = data[start + k + length / 2] * twiddle;
+                data[start + k] = even + odd;
+                data[start + k + length / 2] = even - odd;
+                twiddle *= rotation;
+            }
+        }
+    }
+}
+
+// Rows, then columns through a scratch copy
+static void Fft2D(vector<Complex>& data, size_t n, bool inverse)
+{
+    for (size_t y = 0; y < n; y++)
+    {
+        Fft(&data[y * n], n, inverse);
+    }
+    Complex column[MOTION_WINDOW];
+    for (size_t x = 0; x < n; x++)
+    {
+        for (size_t y = 0; y < n; y++)
+        {
+            column[y] = data[y * n + x];
+        }
+        Fft(column, n, inverse);
+        for (size_t y = 0; y < n; y++)
+        {
+            data[y * n + x] = column[y];
+        }
+    }
+}
+
+MotionSelector::MotionSelector()
+    : m_fraction(0.25),
+      m_maxSkip(0),
+      m_block(0),
+      m_previous(MOTION_WINDOW * MOTION_WINDOW),
+      m_current(MOTION_WINDOW * MOTION_WINDOW),
+      m_cross(MOTION_WINDOW * MOTION_WINDOW),
+      m_taper(MOTION_WINDOW),
+      m_havePrevious(false),
+      m_accumX(0.0),
+      m_accumY(0.0),
+      m_stepX(0.0),
+      m_stepY(0.0),
+      m_sinceKept(0),
+      m_kept(0),
+      m_skipped(0),
+      m_extrapolated(0)
+{
+    // taper the window edges so the wrap-around seam does not correlate
+    for (size_t i = 0; i < MOTION_WINDOW; i++)
+    {
+        m_taper[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * (double)i / (MOTION_WINDOW - 1)));
+    }
+}
+
+void MotionSelector::Init(double fraction, unsigned int maxSkip)
+{
+    m_fraction = fraction;
+    m_maxSkip = maxSkip;
+    m_havePrevious = false;
+}
+
+void MotionSelector::LoadWindow(const uint8_t* pixels, size_t width, size_t height, size_t stride,
+                                unsigned int bytesPerPixel)
+{
+    const size_t n = MOTION_WINDOW;
+    const size_t b = m_block;
+    const size_t x0 = (width - n * b) / 2;
+    const size_t y0 = (height - n * b) / 2;
+    // Mono16 is little endian; its high byte is plenty for correlation
+    const size_t sampleOffset = bytesPerPixel - 1;
+
+    float sum = 0.0f;
+    for (size_t wy = 0; wy < n; wy++)
+    {
+        for (size_t wx = 0; wx < n; wx++)
+        {
+            unsigned int total = 0;
+            for (size_t r = 0; r < b; r++)
+            {
+                const uint8_t* row = pixels + (y0 + wy * b + r) * stride + (x0 + wx * b) * bytesPerPixel + sampleOffset;
+                for (size_t c = 0; c < b; c++)
+                {
+                    total += row[c * bytesPerPixel];
+                }
+            }
+            const float value = (float)total / (float)(b * b);
+            m_current[wy * n + wx] = Complex(value, 0.0f);
+            sum += value;
+        }
+    }
+
+    const float mean = sum / (float)(n * n);
+    for (size_t wy = 0; wy < n; wy++)
+    {
+        for (size_t wx = 0; wx < n; wx++)
+        {
+            Complex& sample = m_current[wy * n + wx];
+            sample = Complex((sample.real() - mean) * m_taper[wx] * m_taper[wy], 0.0f);
+        }
+    }
+    Fft2D(m_current, n, false);
+}
+
+// Subpixel offset of a peak from its larger neighbour. A phase correlation
+// peak is a sampled sinc, for which neighbour / (neighbour + peak) is the
+// exact offset; a parabola fit would pull every step towards the integer and
+// the error would add up over a row.
+static double PeakOffset(float before, float peak, float after)
+{
+    if (after >= before)
+    {
+        return after > 0.0f ? after / (after + peak) : 0.0;
+    }
+    return before > 0.0f ? -before / (before + peak) : 0.0;
+}
+
+bool MotionSelector::Correlate(double& shiftX, double& shiftY)
+{
+    const size_t n = MOTION_WINDOW;
+
+    // normalised cross-power spectrum
+    vector<Complex>& cross = m_cross;
+    for (size_t i = 0; i < n * n; i++)
+    {
+        const Complex product = m_current[i] * conj(m_previous[i]);
+        const float magnitude = abs(product);
+        cross[i] = magnitude > 1e-12f ? product / magnitude : Complex(0.0f, 0.0f);
+    }
+    Fft2D(cross, n, true);
+
+    size_t best = 0;
+    for (size_t i = 1; i < n * n; i++)
+    {
+        if (cross[i].real() > cross[best].real())
+        {
+            best = i;
+        }
+    }
+    const float peak = cross[best].real();
+    if (peak / (float)(n * n) < MOTION_MIN_PEAK)
+    {
+        return false;
+    }
+
+    const size_t px = best % n;
+    const size_t py = best / n;
+    const double offsetX = PeakOffset(cross[py * n + (px + n - 1) % n].real(), peak, cross[py * n + (px + 1) % n].real());
+    const double offsetY = PeakOffset(cross[((py + n - 1) % n) * n + px].real(), peak, cross[((py + 1) % n) * n + px].real());
+
+    // the surface wraps: peaks past the middle are negative shifts
+    shiftX = (px > n / 2 ? (double)px - n : (double)px) + offsetX;
+    shiftY = (py > n / 2 ? (double)py - n : (double)py) + offsetY;
+    return true;
+}
+
+bool MotionSelector::Offer(const uint8_t* pixels, size_t width, size_t height, size_t stride,
+                           unsigned int bytesPerPixel, double& dx, double& dy)
+{
+    dx = 0.0;
+    dy = 0.0;
+    if (width < MOTION_WINDOW || height < MOTION_WINDOW)
+    {
+        // too small to measure; keep everything
+        m_kept++;
+        return true;
+    }
+
+    const size_t block = min(width, height) / MOTION_WINDOW;
+    if (block != m_block)
+    {
+        // new frame size (e.g. the region changed); start over
+        m_block = block;
+        m_havePrevious = false;
+    }
+
+    LoadWindow(pixels, width, height, stride, bytesPerPixel);
+    const bool first = !m_havePrevious;
+    if (!first)
+    {
+        double shiftX = 0.0;
+        double shiftY = 0.0;
+        if (Correlate(shiftX, shiftY))
+        {
+            m_stepX = shiftX;
+            m_stepY = shiftY;
+        }
+        else
+        {
+            shiftX = m_stepX;
+            shiftY = m_stepY;
+            m_extrapolated++;
+        }
+        m_accumX += shiftX;
+        m_accumY += shiftY;
+    }
+    swap(m_previous, m_current);
+    m_havePrevious = true;
+    m_sinceKept++;
+
+    dx = m_accumX * (double)m_block;
+    dy = m_accumY * (double)m_block;
+    const bool keep = first || fabs(dx) >= m_fraction * (double)width || fabs(dy) >= m_fraction * (double)height ||
+                      (m_maxSkip > 0 && m_sinceKept >= m_maxSkip);
+    if (keep)
+    {
+        m_accumX = 0.0;
+        m_accumY = 0.0;
+        m_sinceKept = 0;
+        m_kept++;
+    }
+    else
+    {
+        m_skipped++;
+    }
+    return keep;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <complex>
+#include <vector>
+
+// Side of the square, power-of-two window frames are reduced to for phase
+// correlation
+#define MOTION_WINDOW 128
+
+// Keeps a frame only once the view has moved a set fraction of the field of
+// view since the last kept one, so a free-running camera on a slow stage does
+// not save dozens of near-identical tiles per field.
+//
+// Motion is measured between consecutive frames by phase correlation on a
+// MOTION_WINDOW square, box-averaged from the centre of the frame, and
+// accumulated until the next frame is kept. Consecutive frames barely move,
+// which keeps the peak well inside the window. On featureless areas (bare
+// glass) the correlation peak is too weak to trust, and the last reliable
+// per-frame motion is assumed instead, since the stage moves at constant
+// speed along a row.
+//
+// Runs on the grab thread: one box average, one forward and one inverse
+// MOTION_WINDOW^2 FFT per frame.
+class MotionSelector
+{
+public:
+    MotionSelector();
+
+    // fraction of the frame width/height to move between kept frames;
+    // maxSkip > 0 keeps at least every maxSkip-th frame regardless
+    void Init(double fraction, unsigned int maxSkip);
+
+    // bytesPerPixel is 1 for Mono8 or 2 for Mono16 (high byte used). Returns
+    // true if the frame should be kept. dx, dy are the accumulated motion in
+    // full-resolution pixels at the time of the decision.
+    bool Offer(const uint8_t* pixels, size_t width, size_t height, size_t stride, unsigned int bytesPerPixel,
+               double& dx, double& dy);
+
+    uint64_t GetKept() const { return m_kept; }
+    uint64_t GetSkipped() const { return m_skipped; }
+    uint64_t GetExtrapolated() const { return m_extrapolated; }
+
+private:
+    void LoadWindow(const uint8_t* pixels, size_t width, size_t height, size_t stride, unsigned int bytesPerPixel);
+    // Shift of m_current relative to m_previous in window pixels; false if the
+    // correlation peak is too weak to trust
+    bool Correlate(double& shiftX, double& shiftY);
+
+    double m_fraction;
+    unsigned int m_maxSkip;
+    size_t m_block; // full-resolution pixels per window pixel
+
+    std::vector<std::complex<float> > m_previous; // spectrum of the last frame
+    std::vector<std::complex<float> > m_current;
+    std::vector<std::complex<float> > m_cross; // correlation scratch
+    std::vector<float> m_taper; // Hann window, one axis
+    bool m_havePrevious;
+
+    double m_accumX; // window pixels moved since the last kept frame
+    double m_accumY;
+    double m_stepX; // last reliable per-frame motion
+    double m_stepY;
+    unsigned int m_sinceKept;
+
+    uint64_t m_kept;
+    uint64_t m_skipped;
+    uint64_t m_extrapolated;
+};
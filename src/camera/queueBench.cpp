@@ -0,0 +1,248 @@
+// Microbenchmark for frameQueue.h: handoff latency and throughput of the SPSC
+// and MPMC rings, against a mutex/condition variable queue like the one in
+// FramePipeline. Each queue runs twice:
+//   saturated - the producer pushes as fast as it can, so the ring sits full
+//               and only throughput means anything
+//   paced     - one handle every pace ns, well below what the consumers take,
+//               so the ring is mostly empty; the producer stamps each handle
+//               with the steady clock and consumers record how long it took
+//               to come out, which is the handoff latency
+//
+//   make queuebench
+//   ./queuebench [items] [consumers] [capacity] [pace ns]
+
+#include "frameQueue.h"
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+static int64_t NowNs()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Stands in for a stream buffer: moved through the ring, never copied
+struct BufferHandle
+{
+    BufferHandle()
+        : index(-1),
+          stampNs(0)
+    {
+    }
+    BufferHandle(int64_t index, int64_t stampNs)
+        : index(index),
+          stampNs(stampNs)
+    {
+    }
+    BufferHandle(BufferHandle&& other)
+        : index(other.index),
+          stampNs(other.stampNs)
+    {
+        other.index = -1;
+    }
+    BufferHandle& operator=(BufferHandle&& other)
+    {
+        index = other.index;
+        stampNs = other.stampNs;
+        other.index = -1;
+        return *this;
+    }
+
+    int64_t index;
+    int64_t stampNs;
+
+private:
+    BufferHandle(const BufferHandle&);
+    BufferHandle& operator=(const BufferHandle&);
+};
+
+// Baseline: the blocking queue the pipeline uses today
+class LockedQueue
+{
+public:
+    explicit LockedQueue(size_t capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    bool TryPush(BufferHandle&& item)
+    {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_items.size() >= m_capacity)
+            {
+                return false;
+            }
+            m_items.push_back(move(item));
+        }
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    bool TryPop(BufferHandle& item)
+    {
+        lock_guard<mutex> lock(m_mutex);
+        if (m_items.empty())
+        {
+            return false;
+        }
+        item = move(m_items.front());
+        m_items.pop_front();
+        return true;
+    }
+
+private:
+    size_t m_capacity;
+    deque<BufferHandle> m_items;
+    mutex m_mutex;
+    condition_variable m_notEmpty;
+};
+
+// handles in each paced run; enough for a stable p99 without taking long
+#define PACED_ITEMS_MAX 200000
+
+struct BenchResult
+{
+    double seconds;
+    uint64_t fullRetries; // pushes that found the ring full
+    bool intact;          // every handle came out exactly once
+    vector<int64_t> latencyNs;
+};
+
+template <typename Queue>
+static BenchResult RunBench(Queue& queue, int64_t items, unsigned int consumers, int64_t paceNs)
+{
+    BenchResult result;
+    result.fullRetries = 0;
+    vector<vector<int64_t> > latencies(consumers);
+    atomic<int64_t> consumed(0);
+    atomic<int64_t> indexSum(0);
+    atomic<bool> go(false);
+
+    vector<thread> threads;
+    for (unsigned int c = 0; c < consumers; c++)
+    {
+        latencies[c].reserve((size_t)(items / consumers + 1));
+        threads.push_back(thread([&, c]() {
+            while (!go.load(memory_order_acquire))
+            {
+            }
+            BufferHandle handle;
+            while (consumed.load(memory_order_relaxed) < items)
+            {
+                if (queue.TryPop(handle))
+                {
+                    latencies[c].push_back(NowNs() - handle.stampNs);
+                    indexSum.fetch_add(handle.index, memory_order_relaxed);
+                    consumed.fetch_add(1, memory_order_relaxed);
+                }
+                else
+                {
+                    this_thread::yield();
+                }
+            }
+        }));
+    }
+
+    go.store(true, memory_order_release);
+    const int64_t startNs = NowNs();
+    for (int64_t i = 0; i < items; i++)
+    {
+        if (paceNs > 0)
+        {
+            // yield rather than sleep: sleeps are far coarser than the pace,
+            // and consumers sharing the core still get to run
+            while (NowNs() < startNs + i * paceNs)
+            {
+                this_thread::yield();
+            }
+        }
+        BufferHandle handle(i, NowNs());
+        while (!queue.TryPush(move(handle)))
+        {
+            result.fullRetries++;
+            handle.stampNs = NowNs();
+            this_thread::yield();
+        }
+    }
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        threads[t].join();
+    }
+    result.seconds = (NowNs() - startNs) / 1e9;
+    result.intact = indexSum.load() == items * (items - 1) / 2;
+
+    for (unsigned int c = 0; c < consumers; c++)
+    {
+        result.latencyNs.insert(result.latencyNs.end(), latencies[c].begin(), latencies[c].end());
+    }
+    sort(result.latencyNs.begin(), result.latencyNs.end());
+    return result;
+}
+
+template <typename Queue>
+static void Report(const string& name, Queue& saturatedQueue, Queue& pacedQueue, int64_t items, int64_t pacedItems,
+                   unsigned int consumers, int64_t paceNs)
+{
+    const BenchResult saturated = RunBench(saturatedQueue, items, consumers, 0);
+    const BenchResult paced = RunBench(pacedQueue, pacedItems, consumers, paceNs);
+    const vector<int64_t>& l = paced.latencyNs;
+    cout << left << setw(18) << name << right << fixed << setprecision(2) << setw(10)
+         << items / saturated.seconds / 1e6 << " M/s" << setw(10) << l[l.size() / 2] << setw(10)
+         << l[l.size() * 99 / 100] << setw(12) << l.back() << setw(12) << paced.fullRetries
+         << (saturated.intact && paced.intact ? "" : "  HANDLES LOST OR DUPLICATED") << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    const int64_t items = argc > 1 ? atoll(argv[1]) : 2000000;
+    const unsigned int consumers = argc > 2 ? (unsigned int)atoi(argv[2]) : 3;
+    const size_t capacity = argc > 3 ? (size_t)atoll(argv[3]) : 64;
+    const int64_t paceNs = argc > 4 ? atoll(argv[4]) : 2000;
+    if (items <= 0 || consumers == 0 || capacity == 0 || paceNs <= 0)
+    {
+        cout << "Usage: queuebench [items] [consumers] [capacity] [pace ns]" << endl;
+        return -1;
+    }
+    const int64_t pacedItems = min(items, (int64_t)PACED_ITEMS_MAX);
+
+    // throughput comes from the saturated run, latency and full retries from
+    // the paced one; a paced run that hits full is pushing faster than the
+    // consumers drain and needs a longer pace
+    cout << items << " handles saturated, " << pacedItems << " paced one per " << paceNs << " ns, capacity "
+         << FrameQueueCapacity(capacity) << ", " << consumers << " consumers for the multi-consumer runs" << endl
+         << left << setw(18) << "queue" << right << setw(14) << "saturated" << setw(10) << "p50 ns" << setw(10)
+         << "p99 ns" << setw(12) << "max ns" << setw(12) << "paced full" << endl;
+
+    {
+        SpscRing<BufferHandle> saturated(capacity), paced(capacity);
+        Report("spsc 1:1", saturated, paced, items, pacedItems, 1, paceNs);
+    }
+    {
+        MpmcRing<BufferHandle> saturated(capacity), paced(capacity);
+        Report("mpmc 1:1", saturated, paced, items, pacedItems, 1, paceNs);
+    }
+    {
+        LockedQueue saturated(FrameQueueCapacity(capacity)), paced(FrameQueueCapacity(capacity));
+        Report("mutex 1:1", saturated, paced, items, pacedItems, 1, paceNs);
+    }
+    {
+        MpmcRing<BufferHandle> saturated(capacity), paced(capacity);
+        Report("mpmc 1:" + to_string(consumers), saturated, paced, items, pacedItems, consumers, paceNs);
+    }
+    {
+        LockedQueue saturated(FrameQueueCapacity(capacity)), paced(FrameQueueCapacity(capacity));
+        Report("mutex 1:" + to_string(consumers), saturated, paced, items, pacedItems, consumers, paceNs);
+    }
+    return 0;
+}
@@ -8,25 +8,345 @@
 #include <time.h>
 //#include <unistd.h>
 #include <thread>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "bufferPool.h"
+#include "captureConfig.h"
+#include "captureDaemon.h"
+#include "frameMetadata.h"
+#include "framePipeline.h"
+#include "frameSource.h"
+#include "motionSelector.h"
+#include "runCam.h"
+#include "streamHealth.h"
+#include "telemetry.h"
+#include "userSet.h"
 using namespace Spinnaker;
 using namespace Spinnaker::GenApi;
 using namespace Spinnaker::GenICam;
 using namespace std;
 
 #define BILLION 1000000000.0
-#define PHOTO_PER_SLIDE 8500
+#define TRIGGER_GRAB_TIMEOUT_MS 10000
 
 
-int AcquireImages(CameraPtr pCam, INodeMap& nodeMap, INodeMap& nodeMapTLDevice,int numphoto)
+// Mono8 with lossless compression on the camera, following the Compression
+// sample's EnableImageCompression. Roughly halves link and disk bandwidth.
+int ConfigureCompression(INodeMap& nodeMap)
+{
+    CEnumerationPtr ptrPixelFormat = nodeMap.GetNode("PixelFormat");
+    if (!IsReadable(ptrPixelFormat) || !IsWritable(ptrPixelFormat))
+    {
+        cout << "Unable to get or set pixel format. Aborting..." << endl << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrPixelFormatMono8 = ptrPixelFormat->GetEntryByName("Mono8");
+    if (!IsReadable(ptrPixelFormatMono8))
+    {
+        cout << "Unable to set pixel format to Mono8. Aborting..." << endl << endl;
+        return -1;
+    }
+    ptrPixelFormat->SetIntValue(ptrPixelFormatMono8->GetValue());
+
+    // the ISP has to be off before compression can be configured; set it after
+    // the pixel format since changing format can turn it back on
+    CBooleanPtr ptrIspEnable = nodeMap.GetNode("IspEnable");
+    if (IsWritable(ptrIspEnable))
+    {
+        ptrIspEnable->SetValue(false);
+    }
+
+    CEnumerationPtr ptrCompressionMode = nodeMap.GetNode("ImageCompressionMode");
+    if (!IsWritable(ptrCompressionMode))
+    {
+        cout << "Unable to set image compression mode to Lossless (enum retrieval). Aborting..." << endl << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrCompressionModeLossless = ptrCompressionMode->GetEntryByName("Lossless");
+    if (!IsReadable(ptrCompressionModeLossless))
+    {
+        cout << "Unable to set image compression mode to Lossless (entry retrieval). Aborting..." << endl << endl;
+        return -1;
+    }
+    ptrCompressionMode->SetIntValue(ptrCompressionModeLossless->GetValue());
+
+    cout << "Lossless compression enabled..." << endl;
+    return 0;
+}
+
+// Puts the camera in charge of frame timing; same node sequence as the
+// GigEVisionPerformance sample's EnableManualFramerate/SetFrameRate
+int ConfigureFrameRate(INodeMap& nodeMap, double frameRate)
+{
+    CBooleanPtr ptrFrameRateEnable = nodeMap.GetNode("AcquisitionFrameRateEnable");
+    if (ptrFrameRateEnable == nullptr)
+    {
+        // AcquisitionFrameRateEnabled is used for Gen2 devices
+        ptrFrameRateEnable = nodeMap.GetNode("AcquisitionFrameRateEnabled");
+    }
+    if (IsWritable(ptrFrameRateEnable))
+    {
+        ptrFrameRateEnable->SetValue(true);
+    }
+
+    // Gen2 devices also need the automatic frame rate turned off
+    CEnumerationPtr ptrFrameRateAuto = nodeMap.GetNode("AcquisitionFrameRateAuto");
+    if (IsReadable(ptrFrameRateAuto) && IsWritable(ptrFrameRateAuto))
+    {
+        CEnumEntryPtr ptrFrameRateAutoOff = ptrFrameRateAuto->GetEntryByName("Off");
+        if (IsReadable(ptrFrameRateAutoOff))
+        {
+            ptrFrameRateAuto->SetIntValue(ptrFrameRateAutoOff->GetValue());
+        }
+    }
+
+    CFloatPtr ptrFrameRate = nodeMap.GetNode("AcquisitionFrameRate");
+    if (!IsReadable(ptrFrameRate) || !IsWritable(ptrFrameRate))
+    {
+        cout << "Unable to set AcquisitionFrameRate. Aborting..." << endl << endl;
+        return -1;
+    }
+
+    double frameRateToSet = frameRate;
+    if (frameRateToSet > ptrFrameRate->GetMax())
+    {
+        frameRateToSet = ptrFrameRate->GetMax();
+        cout << "Requested frame rate exceeds camera limit, clamping" << endl;
+    }
+    ptrFrameRate->SetValue(frameRateToSet);
+
+    // What the sensor will actually deliver with the current exposure
+    CFloatPtr ptrResultingFrameRate = nodeMap.GetNode("AcquisitionResultingFrameRate");
+    if (IsReadable(ptrResultingFrameRate))
+    {
+        cout << "Frame rate set to " << frameRateToSet << " fps (resulting " << ptrResultingFrameRate->GetValue()
+             << " fps)..." << endl;
+    }
+    else
+    {
+        cout << "Frame rate set to " << frameRateToSet << " fps..." << endl;
+    }
+    return 0;
+}
+
+// Frame start on a rising edge of the given input line, following the
+// Trigger sample's ConfigureTrigger. Trigger mode must be off while the
+// selector and source are changed.
+int ConfigureTrigger(INodeMap& nodeMap, const string& line)
+{
+    CEnumerationPtr ptrTriggerMode = nodeMap.GetNode("TriggerMode");
+    if (!IsReadable(ptrTriggerMode) || !IsWritable(ptrTriggerMode))
+    {
+        cout << "Unable to disable trigger mode (node retrieval). Aborting..." << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrTriggerModeOff = ptrTriggerMode->GetEntryByName("Off");
+    if (!IsReadable(ptrTriggerModeOff))
+    {
+        cout << "Unable to disable trigger mode (enum entry retrieval). Aborting..." << endl;
+        return -1;
+    }
+    ptrTriggerMode->SetIntValue(ptrTriggerModeOff->GetValue());
+
+    CEnumerationPtr ptrTriggerSelector = nodeMap.GetNode("TriggerSelector");
+    if (!IsReadable(ptrTriggerSelector) || !IsWritable(ptrTriggerSelector))
+    {
+        cout << "Unable to get or set trigger selector (node retrieval). Aborting..." << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrTriggerSelectorFrameStart = ptrTriggerSelector->GetEntryByName("FrameStart");
+    if (!IsReadable(ptrTriggerSelectorFrameStart))
+    {
+        cout << "Unable to get trigger selector (enum entry retrieval). Aborting..." << endl;
+        return -1;
+    }
+    ptrTriggerSelector->SetIntValue(ptrTriggerSelectorFrameStart->GetValue());
+
+    CEnumerationPtr ptrTriggerSource = nodeMap.GetNode("TriggerSource");
+    if (!IsReadable(ptrTriggerSource) || !IsWritable(ptrTriggerSource))
+    {
+        cout << "Unable to get or set trigger source (node retrieval). Aborting..." << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrTriggerSourceLine = ptrTriggerSource->GetEntryByName(line.c_str());
+    if (!IsReadable(ptrTriggerSourceLine))
+    {
+        cout << "Unable to set trigger source to " << line << " (enum entry retrieval). Aborting..." << endl;
+        return -1;
+    }
+    ptrTriggerSource->SetIntValue(ptrTriggerSourceLine->GetValue());
+
+    // the stage raises the line with the step pulse
+    CEnumerationPtr ptrTriggerActivation = nodeMap.GetNode("TriggerActivation");
+    if (IsWritable(ptrTriggerActivation))
+    {
+        CEnumEntryPtr ptrRisingEdge = ptrTriggerActivation->GetEntryByName("RisingEdge");
+        if (IsReadable(ptrRisingEdge))
+        {
+            ptrTriggerActivation->SetIntValue(ptrRisingEdge->GetValue());
+        }
+    }
+
+    CEnumEntryPtr ptrTriggerModeOn = ptrTriggerMode->GetEntryByName("On");
+    if (!IsReadable(ptrTriggerModeOn))
+    {
+        cout << "Unable to enable trigger mode (enum entry retrieval). Aborting..." << endl;
+        return -1;
+    }
+    ptrTriggerMode->SetIntValue(ptrTriggerModeOn->GetValue());
+
+    cout << "Hardware trigger on " << line << " enabled..." << endl;
+    return 0;
+}
+
+// Returns the camera to free-running, as the Trigger sample's ResetTrigger
+int ResetTrigger(INodeMap& nodeMap)
+{
+    CEnumerationPtr ptrTriggerMode = nodeMap.GetNode("TriggerMode");
+    if (!IsReadable(ptrTriggerMode) || !IsWritable(ptrTriggerMode))
+    {
+        cout << "Unable to disable trigger mode (node retrieval). Non-fatal error..." << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrTriggerModeOff = ptrTriggerMode->GetEntryByName("Off");
+    if (!IsReadable(ptrTriggerModeOff))
+    {
+        cout << "Unable to disable trigger mode (enum entry retrieval). Non-fatal error..." << endl;
+        return -1;
+    }
+    ptrTriggerMode->SetIntValue(ptrTriggerModeOff->GetValue());
+    return 0;
+}
+
+// Sets an integer node to value, rounded down onto the node's increment and
+// clamped to its current range. Returns the value set, or -1 if the node
+// cannot be written.
+int64_t SetAlignedInteger(INodeMap& nodeMap, const char* name, int64_t value)
+{
+    CIntegerPtr ptrNode = nodeMap.GetNode(name);
+    if (!IsReadable(ptrNode) || !IsWritable(ptrNode))
+    {
+        return -1;
+    }
+    const int64_t minimum = ptrNode->GetMin();
+    const int64_t maximum = ptrNode->GetMax();
+    const int64_t increment = ptrNode->GetInc() > 0 ? ptrNode->GetInc() : 1;
+    if (value > maximum)
+    {
+        value = maximum;
+    }
+    value = minimum + (value - minimum) / increment * increment;
+    if (value < minimum)
+    {
+        value = minimum;
+    }
+    ptrNode->SetValue(value);
+    return value;
+}
+
+// Binning or decimation in both directions. Some models only expose the
+// vertical node and follow it horizontally, so the horizontal one is optional.
+int ConfigureSubsampling(INodeMap& nodeMap, const char* kind, unsigned int factor)
+{
+    const string vertical = string(kind) + "Vertical";
+    const string horizontal = string(kind) + "Horizontal";
+    CIntegerPtr ptrVertical = nodeMap.GetNode(vertical.c_str());
+    if (!IsReadable(ptrVertical) || !IsWritable(ptrVertical))
+    {
+        if (factor == 1)
+        {
+            return 0;
+        }
+        cout << "Unable to set " << vertical << " (node retrieval). Aborting..." << endl;
+        return -1;
+    }
+    if ((int64_t)factor > ptrVertical->GetMax())
+    {
+        cout << kind << " " << factor << " not supported, maximum " << ptrVertical->GetMax() << ". Aborting..."
+             << endl;
+        return -1;
+    }
+    ptrVertical->SetValue(factor);
+
+    CIntegerPtr ptrHorizontal = nodeMap.GetNode(horizontal.c_str());
+    if (IsWritable(ptrHorizontal))
+    {
+        ptrHorizontal->SetValue(factor);
+    }
+    return 0;
+}
+
+// Sensor readout region, binning and decimation; must be applied before
+// BeginAcquisition since they change the payload size. The camera keeps these
+// settings between runs, so the full sensor is restored when none are asked
+// for. Offsets are zeroed first so the new width and height are not limited by
+// the previous region.
+int ConfigureRegion(INodeMap& nodeMap, const CaptureConfig& config)
+{
+    SetAlignedInteger(nodeMap, "OffsetX", 0);
+    SetAlignedInteger(nodeMap, "OffsetY", 0);
+
+    // averaging keeps binned previews at the same brightness as full frames
+    CEnumerationPtr ptrBinningMode = nodeMap.GetNode("BinningVerticalMode");
+    if (config.binning > 1 && IsWritable(ptrBinningMode))
+    {
+        CEnumEntryPtr ptrBinningAverage = ptrBinningMode->GetEntryByName("Average");
+        if (IsReadable(ptrBinningAverage))
+        {
+            ptrBinningMode->SetIntValue(ptrBinningAverage->GetValue());
+        }
+    }
+    if (ConfigureSubsampling(nodeMap, "Binning", config.binning) != 0 ||
+        ConfigureSubsampling(nodeMap, "Decimation", config.decimation) != 0)
+    {
+        return -1;
+    }
+
+    // region is given in sensor pixels, the nodes count output pixels
+    const int64_t scale = (int64_t)config.binning * config.decimation;
+    const bool fullSensor = config.roiWidth == 0 || config.roiHeight == 0;
+    CIntegerPtr ptrWidth = nodeMap.GetNode("Width");
+    CIntegerPtr ptrHeight = nodeMap.GetNode("Height");
+    if (!IsReadable(ptrWidth) || !IsReadable(ptrHeight))
+    {
+        cout << "Unable to read image size. Aborting..." << endl;
+        return -1;
+    }
+    const int64_t width = SetAlignedInteger(nodeMap, "Width", fullSensor ? ptrWidth->GetMax() : config.roiWidth / scale);
+    const int64_t height =
+        SetAlignedInteger(nodeMap, "Height", fullSensor ? ptrHeight->GetMax() : config.roiHeight / scale);
+    if (width < 0 || height < 0)
+    {
+        if (fullSensor)
+        {
+            cout << "Image size not writable, keeping " << ptrWidth->GetValue() << "x" << ptrHeight->GetValue()
+                 << "..." << endl;
+            return 0;
+        }
+        cout << "Unable to set image size. Aborting..." << endl;
+        return -1;
+    }
+    if (!fullSensor)
+    {
+        SetAlignedInteger(nodeMap, "OffsetX", config.roiOffsetX / scale);
+        SetAlignedInteger(nodeMap, "OffsetY", config.roiOffsetY / scale);
+    }
+
+    CIntegerPtr ptrOffsetX = nodeMap.GetNode("OffsetX");
+    CIntegerPtr ptrOffsetY = nodeMap.GetNode("OffsetY");
+    cout << "Image size " << width << "x" << height;
+    if (IsReadable(ptrOffsetX) && IsReadable(ptrOffsetY))
+    {
+        cout << " at " << ptrOffsetX->GetValue() << "," << ptrOffsetY->GetValue();
+    }
+    cout << " (binning " << config.binning << ", decimation " << config.decimation << ")..." << endl;
+    return 0;
+}
+
+int AcquireImages(CameraPtr pCam, INodeMap& nodeMap, INodeMap& nodeMapTLDevice, const CaptureConfig& config,
+                  CaptureControl* control)
 {
-    int result = 0;
-    double difference;
-    //struct timespec start,end;
-    //clock_gettime(CLOCK_MONOTONIC, &start);
-    auto start = chrono::high_resolution_clock::now();
-    
-    ios_base::sync_with_stdio(false);
-    
     cout << endl << endl << "*** IMAGE ACQUISITION ***" << endl << endl;
 
     try
@@ -52,76 +372,275 @@ int AcquireImages(CameraPtr pCam, INodeMap& nodeMap, INodeMap& nodeMapTLDevice,i
         // Retrieve integer value from entry node
         const int64_t acquisitionModeContinuous = ptrAcquisitionModeContinuous->GetValue();
         
-        // Set integer value from entry node as new value of enumeration node
-        ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
+        // Set integer value from entry node as new value of enumeration node;
+        // a loaded user set already has it
+        if (ptrAcquisitionMode->GetIntValue() != acquisitionModeContinuous)
+        {
+            ptrAcquisitionMode->SetIntValue(acquisitionModeContinuous);
+        }
 
         cout << "Acquisition mode set to continuous..." << endl;
 
+        if (config.compression && ConfigureCompression(nodeMap) != 0)
+        {
+            return -1;
+        }
+
+        const bool triggered = !config.triggerLine.empty();
+        if (triggered)
+        {
+            if (config.frameRate > 0)
+            {
+                cout << "Hardware trigger paces capture, --frame-rate ignored" << endl;
+            }
+            if (ConfigureTrigger(nodeMap, config.triggerLine) != 0)
+            {
+                return -1;
+            }
+        }
+        else if (config.frameRate > 0 && ConfigureFrameRate(nodeMap, config.frameRate) != 0)
+        {
+            return -1;
+        }
+
+        // Per-frame timestamps come from the camera; without chunk data we
+        // fall back to the host clock at dequeue
+        ClockLatch latch;
+        if (config.useChunkData && ConfigureChunkData(nodeMap) != 0)
+        {
+            cout << "Chunk data incomplete, frame times will use the host clock" << endl;
+        }
+        if (config.useChunkData)
+        {
+            LatchDeviceClock(nodeMap, latch);
+        }
+
+        CameraFrameSource source(pCam);
+        const int result = AcquireFrames(source, config, latch, control);
+        if (triggered)
+        {
+            ResetTrigger(nodeMap);
+        }
+        return result;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error: " << e.what() << endl;
+        return -1;
+    }
+}
+
+// Offers an uncompressed Mono8/Mono16 frame to the motion selector; frames it
+// cannot measure are always kept
+bool IsNewView(MotionSelector& selector, const ImagePtr& image)
+{
+    unsigned int bytesPerPixel = 0;
+    if (image->GetPixelFormat() == PixelFormat_Mono8)
+    {
+        bytesPerPixel = 1;
+    }
+    else if (image->GetPixelFormat() == PixelFormat_Mono16)
+    {
+        bytesPerPixel = 2;
+    }
+    if (bytesPerPixel == 0 || image->IsCompressed())
+    {
+        return true;
+    }
+    double dx = 0.0;
+    double dy = 0.0;
+    return selector.Offer(static_cast<const uint8_t*>(image->GetData()), image->GetWidth(), image->GetHeight(),
+                          image->GetStride(), bytesPerPixel, dx, dy);
+}
+
+// The acquisition loop proper: grabs from source and feeds the worker pool
+// until the scan's frame count is reached, or control asks it to stop
+int AcquireFrames(FrameSource& source, const CaptureConfig& config, const ClockLatch& latch,
+                  CaptureControl* control)
+{
+    int result = 0;
+    double difference;
+    uint64_t incomplete = 0;
+    //struct timespec start,end;
+    //clock_gettime(CLOCK_MONOTONIC, &start);
+    int64_t start = HostMonotonicNs();
+
+    try
+    {
+        // With a frame rate or the stage's trigger the camera paces capture
+        // and every grab is kept; otherwise fall back to grabbing on even
+        // iterations and sleeping on odd
+        const bool triggered = !config.triggerLine.empty();
+        const bool cameraTimed = config.frameRate > 0 || triggered;
+        int iterations = 20*config.numphoto;
+        uint64_t grabTimeout = 1000;
+        if (triggered)
+        {
+            // one frame per trigger; row changes and the first command poll
+            // leave the line quiet for seconds at a time
+            iterations = ScanTriggerCount(config);
+            grabTimeout = TRIGGER_GRAB_TIMEOUT_MS;
+            cout << "Stage-triggered capture of " << iterations << " frames, one every " << config.triggerSteps
+                 << " X steps over " << ScanRows(config) << " rows" << endl;
+        }
+        else if (cameraTimed)
+        {
+            iterations = ScanFrameCount(config);
+            // allow a few frame periods before calling a grab late
+            const uint64_t framePeriodMs = (uint64_t)(1000.0 / config.frameRate);
+            if (3 * framePeriodMs > grabTimeout)
+            {
+                grabTimeout = 3 * framePeriodMs;
+            }
+            cout << "Camera-timed capture of " << iterations << " frames over " << ScanRows(config) << " rows" << endl;
+        }
+
+        FrameLog frameLog;
+        CaptureWriter captureWriter;
+        if (config.output == OUTPUT_CONTAINER &&
+            captureWriter.Open(config.captureName, config.preallocBytes) != 0)
+        {
+            return -1;
+        }
         
-        // Begin acquiring images
-        pCam->BeginAcquisition();
+        // Conversion and saving happen on the worker pool so the loop below
+        // only ever waits on the camera
+        CaptureTelemetry telemetry;
+        telemetry.Init(config.numWorkers, config.filePrefix);
+        // declared before the pipeline so it outlives the workers
+        FlatFieldCorrection flatField;
+        FramePipeline pipeline(config, &frameLog, config.output == OUTPUT_CONTAINER ? &captureWriter : nullptr,
+                               config.metrics ? &telemetry : nullptr);
 
-        cout << "Acquiring images..." << endl;
+        // Our own stream buffers, plus one conversion target per worker, so
+        // steady-state capture never goes back to the allocator. The source
+        // keeps its stream buffers until it is destroyed, after EndAcquisition.
+        if (source.PrepareStream(config) != 0)
+        {
+            return -1;
+        }
+        size_t frameWidth = 0;
+        size_t frameHeight = 0;
+        if (source.GetFrameSize(frameWidth, frameHeight))
+        {
+            pipeline.SetFrameSize(frameWidth, frameHeight);
+            if (config.userBuffers > 0 &&
+                pipeline.PrepareConversionBuffers(frameWidth, frameHeight, config.hugePages) != 0)
+            {
+                return -1;
+            }
+        }
 
+        // Calibration maps must match the frames, including any ROI/binning
+        if (!config.darkFrame.empty() || !config.flatFrame.empty())
+        {
+            if (flatField.Load(config.darkFrame, config.flatFrame) != 0)
+            {
+                return -1;
+            }
+            if (flatField.GetWidth() != frameWidth || flatField.GetHeight() != frameHeight)
+            {
+                cout << "Calibration frames are " << flatField.GetWidth() << "x" << flatField.GetHeight()
+                     << " but the capture is " << frameWidth << "x" << frameHeight << ". Aborting..." << endl;
+                return -1;
+            }
+            pipeline.SetFlatField(&flatField);
+        }
+        FrameIdTracker frameIds;
+        MotionSelector selector;
+        selector.Init(config.selectFraction, config.selectMaxSkip);
+        uint64_t redundant = 0;
+        pipeline.Start();
 
-        // Create ImageProcessor instance for post processing images
-        ImageProcessor processor;
+        frameLog.Open(config.filePrefix + "-frames.csv", latch);
+        if (config.metrics)
+        {
+            telemetry.StartExport(config.filePrefix + "-metrics.prom", config.metricsInterval);
+        }
+        start = HostMonotonicNs();
+        int64_t lastStreamPoll = start;
+        
+        // Begin acquiring images
+        source.BeginAcquisition();
+        if (control != nullptr)
+        {
+            control->NotifyStarted();
+        }
 
-        // Set default image processor color processing method 
-        processor.SetColorProcessing(SPINNAKER_COLOR_PROCESSING_ALGORITHM_HQ_LINEAR);
-        //auto start = std::chrono::high_resolution_clock::now();
+        cout << "Acquiring images..." << endl;
 
-        for (int imageCnt = 0; imageCnt < 20*numphoto; imageCnt++)
+        for (int imageCnt = 0; imageCnt < iterations; imageCnt++)
         {
-            if(imageCnt % 2 == 0){
+            if (control != nullptr && control->stopRequested.load())
+            {
+                cout << "Stop requested after " << imageCnt << " iterations" << endl;
+                break;
+            }
+            if(cameraTimed || imageCnt % 2 == 0){
                 try
                 {
                     // Retrieve next received image
-                    ImagePtr pResultImage = pCam->GetNextImage(1000);
-                    //auto elapsed = std::chrono::high_resolution_clock::now() - start;
+                    FrameInfo info;
+                    ImagePtr pResultImage = source.GetNextImage(grabTimeout, info);
+
+                    //clock_gettime(CLOCK_MONOTONIC, &end);
+                    int64_t end = HostMonotonicNs();
+                    const int64_t grabNs = end;
+
+                    // the stream nodemap is only touched from this thread
+                    if (config.metrics && end - lastStreamPoll >= (int64_t)(config.metricsInterval * BILLION))
+                    {
+                        int64_t dropped = 0;
+                        int64_t lost = 0;
+                        source.ReadStreamCounters(dropped, lost);
+                        telemetry.SetStreamCounters(dropped, lost);
+                        lastStreamPoll = end;
+                    }
+
                     // Ensure image completion
-                    if (pResultImage->IsIncomplete())
+                    frameIds.Record(info.frameId);
+                    if (info.incomplete)
                     {
                         // Retrieve and print the image status description
-                        cout << "Image incomplete: " << Image::GetImageStatusDescription(pResultImage->GetImageStatus())
-                            << "..." << endl
-                            << endl;
+                        cout << "Image incomplete: "
+                             << Image::GetImageStatusDescription((ImageStatus)info.imageStatus) << "..." << endl
+                             << endl;
+                        incomplete++;
+                        telemetry.RecordIncomplete(info.imageStatus);
+                        ReleaseFrame(pResultImage, info.streamBuffer);
+                    }
+                    else if (config.selectMotion && !IsNewView(selector, pResultImage))
+                    {
+                        // the workers never see it, so it goes straight back
+                        redundant++;
+                        ReleaseFrame(pResultImage, info.streamBuffer);
                     }
                     else
                     {
-                        // Print image information; height and width recorded in pixels
-
-                        const size_t width = pResultImage->GetWidth();
-
-                        const size_t height = pResultImage->GetHeight();
-
-                        cout << "Grabbed image " << imageCnt << ", width = " << width << ", height = " << height << endl;
-
-                        ImagePtr convertedImage = processor.Convert(pResultImage, PixelFormat_Mono8);
-
-                        //make file 
-                        ostringstream filename;
-                        //long long microseconds = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
-
-                        //clock_gettime(CLOCK_MONOTONIC, &end);
-                        auto end = chrono::high_resolution_clock::now();
-			
-			//difference = double(end.tv_sec - start.tv_sec) + (double(end.tv_nsec - start.tv_nsec) / BILLION);
-			difference = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
-			
-                        difference = difference / BILLION;
-
-			filename << "SuperStitch-";
-                        filename << difference << ".jpg";
-
-                        // Save image
-                        convertedImage->Save(filename.str().c_str());
-
-                        cout << "Image saved at " << filename.str() << endl;
+                        // Hand the frame to the workers; they release it once converted
+                        FrameJob job;
+                        job.image = pResultImage;
+                        job.streamBuffer = info.streamBuffer;
+                        job.grabIndex = imageCnt;
+                        job.grabNs = grabNs;
+                        ReadFrameMetadata(pResultImage, latch, job.meta);
+                        if (!job.meta.hasChunk)
+                        {
+                            job.meta.frameId = info.frameId;
+                        }
+                        if (job.meta.hostMonotonicNs != 0)
+                        {
+                            // exposure start on the host timeline
+                            end = job.meta.hostMonotonicNs;
+                        }
+                        else
+                        {
+                            job.meta.hostMonotonicNs = end;
+                        }
+                        difference = double(end - start) / BILLION;
+                        job.hostTime = difference;
+                        pipeline.Submit(job);
                     }
-
-                    pResultImage->Release();
-                    cout << endl;
                 }
                 catch (Spinnaker::Exception& e)
                 {
@@ -134,7 +653,55 @@ int AcquireImages(CameraPtr pCam, INodeMap& nodeMap, INodeMap& nodeMapTLDevice,i
             }
         }
 
-        pCam->EndAcquisition();
+        // Drain whatever is still queued; workers hand their buffers back to
+        // the stream, which has to happen before EndAcquisition
+        pipeline.Finish();
+        const int64_t streamLost = source.ReportStreamStatistics();
+        if (config.metrics)
+        {
+            int64_t dropped = 0;
+            int64_t lost = 0;
+            source.ReadStreamCounters(dropped, lost);
+            telemetry.SetStreamCounters(dropped, lost);
+            telemetry.StopExport();
+        }
+        source.EndAcquisition();
+        frameLog.Close();
+        captureWriter.Close();
+
+        const PipelineStats stats = pipeline.GetStats();
+        cout << endl << "Frames queued: " << stats.submitted << ", written: " << stats.written
+             << ", failed: " << stats.failed << ", dropped (queue full): " << stats.dropped
+             << ", incomplete: " << incomplete << ", peak queue depth: " << stats.maxDepth << endl;
+        cout << "Frames saved without conversion: " << stats.fastPath << " of " << stats.written + stats.failed << endl;
+        if (config.minSharpness > 0)
+        {
+            cout << "Frames dropped as blurry: " << stats.blurry << " (sharpness under " << config.minSharpness << ")"
+                 << endl;
+        }
+        if (config.selectMotion)
+        {
+            cout << "Frames skipped as redundant: " << redundant << " of " << redundant + stats.submitted
+                 << " (motion estimate extrapolated on " << selector.GetExtrapolated() << ")" << endl;
+        }
+        if (config.compression)
+        {
+            cout << "Frames received compressed: " << stats.compressed
+                 << (config.storeCompressed ? " (stored compressed)" : " (decompressed on host)") << endl;
+        }
+        frameIds.Report();
+        if (streamLost == 0 && frameIds.GetMissing() == 0)
+        {
+            cout << "No frames lost between camera and host" << endl;
+        }
+        else
+        {
+            cout << "WARNING: frames were lost between camera and host, check buffer settings" << endl;
+        }
+        if (stats.failed > 0)
+        {
+            result = -1;
+        }
     }
     catch (Spinnaker::Exception& e)
     {
@@ -146,7 +713,113 @@ int AcquireImages(CameraPtr pCam, INodeMap& nodeMap, INodeMap& nodeMapTLDevice,i
 
 }
 
-int RunSingleCamera(CameraPtr pCam,int numphoto)
+// Exposure, gain and metering settings shared by every camera we run
+int ConfigureCamera(INodeMap& nodeMap)
+{
+    int result = 0;
+    //set Exposure 
+    CEnumerationPtr ptrExposureAuto = nodeMap.GetNode("ExposureAuto");
+    if (IsReadable(ptrExposureAuto) && IsWritable(ptrExposureAuto)){
+        CEnumEntryPtr ptrExposureAutoOn = ptrExposureAuto->GetEntryByName("Off");
+        if (IsReadable(ptrExposureAutoOn)){
+            ptrExposureAuto->SetIntValue(ptrExposureAutoOn->GetValue());
+            cout << "Automatic exposure enabled..." << ptrExposureAutoOn->GetValue() << endl;
+        }
+    }
+    else 
+    {
+        CEnumerationPtr ptrAutoBright = nodeMap.GetNode("autoBrightnessMode");
+        if (!IsReadable(ptrAutoBright) ||
+            !IsWritable(ptrAutoBright))
+        {
+            cout << "Unable to get or set exposure time. Aborting..." << endl << endl;
+            return -1;
+        }
+        cout << "Unable to disable automatic exposure. Expected for some models... " << endl;
+        cout << "Proceeding..." << endl;
+        result = 1;
+    }
+    
+    CFloatPtr ptrExposureTime = nodeMap.GetNode("ExposureTime");
+    const double exposureTimeMax = ptrExposureTime->GetMax();
+    double exposureTimeToSet = 1000.0;
+
+    if (exposureTimeToSet > exposureTimeMax)
+    {
+        exposureTimeToSet = exposureTimeMax;
+    }
+
+    ptrExposureTime->SetValue(exposureTimeToSet);
+    //CEnumerationPtr ptrExposureAuto=nodeMap.GetNode("ExposureAuto");
+    //CEnumEntryPtr ptrExposureAutoCts=ptrExposureAuto->GetEntryByName("Continuous");
+    //ptrExposureAuto->SetIntValue(ptrExposureAutoCts->GetValue());
+    CEnumerationPtr ptrGainAuto=nodeMap.GetNode("GainAuto");
+    CEnumEntryPtr ptrGainAutoCts=ptrGainAuto->GetEntryByName("Continuous");
+    ptrGainAuto->SetIntValue(ptrGainAutoCts->GetValue());
+    //Set Metering Mode
+    CEnumerationPtr ptrMeteringMode=nodeMap.GetNode("AutoExposureMeteringMode");
+    CEnumEntryPtr ptrMeteringModePartial=ptrMeteringMode->GetEntryByName("Partial");
+    ptrMeteringMode->SetIntValue(ptrMeteringModePartial->GetValue());
+    //
+    //Goin/ExposureTime
+    //CEnumerationPtr exposurePriorityNode = nodeMap.GetNode("ExposurePriority");
+    //exposurePriorityNode->SetIntValue(1);
+    //CEnumerationPtr gainPriorityNode = nodeMap.GetNode("GainPriority");
+    //gainPriorityNode->SetIntValue(1);
+    return result;
+}
+
+int BringUpCamera(INodeMap& nodeMap, const CaptureConfig& config)
+{
+    const int64_t start = HostMonotonicNs();
+    int result = 0;
+    if (!config.useUserSet || LoadUserSet(nodeMap, config) != 0)
+    {
+        result = ConfigureCamera(nodeMap);
+        if (result < 0)
+        {
+            return result;
+        }
+        if (ConfigureRegion(nodeMap, config) != 0)
+        {
+            return -1;
+        }
+    }
+    cout << "Camera configured in " << double(HostMonotonicNs() - start) / 1e6 << " ms" << endl;
+    return result;
+}
+
+// "camrunner provision": configures every detected camera once and saves the
+// result to User Set 1, so later runs with the same options just load it
+int ProvisionCameras(CameraList& camList, const CaptureConfig& config)
+{
+    int result = 0;
+    for (unsigned int i = 0; i < camList.GetSize(); i++)
+    {
+        CameraPtr pCam = camList.GetByIndex(i);
+        try
+        {
+            pCam->Init();
+            cout << "Provisioning camera " << i << "..." << endl;
+            INodeMap& nodeMap = pCam->GetNodeMap();
+            // start from the factory set so per-run settings are not saved too
+            if (LoadDefaultUserSet(nodeMap) != 0 || ConfigureCamera(nodeMap) < 0 ||
+                ConfigureRegion(nodeMap, config) != 0 || SaveUserSet(nodeMap, config) != 0)
+            {
+                result = -1;
+            }
+            pCam->DeInit();
+        }
+        catch (Spinnaker::Exception& e)
+        {
+            cout << "Error: " << e.what() << endl;
+            result = -1;
+        }
+    }
+    return result;
+}
+
+int RunSingleCamera(CameraPtr pCam, const CaptureConfig& config)
 {
     int result = 0;
     try
@@ -160,60 +833,96 @@ int RunSingleCamera(CameraPtr pCam,int numphoto)
 
         // Retrieve GenICam nodemap
         INodeMap& nodeMap = pCam->GetNodeMap();
-        //set Exposure 
-        CEnumerationPtr ptrExposureAuto = nodeMap.GetNode("ExposureAuto");
-        if (IsReadable(ptrExposureAuto) && IsWritable(ptrExposureAuto)){
-            CEnumEntryPtr ptrExposureAutoOn = ptrExposureAuto->GetEntryByName("Off");
-            if (IsReadable(ptrExposureAutoOn)){
-                ptrExposureAuto->SetIntValue(ptrExposureAutoOn->GetValue());
-                cout << "Automatic exposure enabled..." << ptrExposureAutoOn->GetValue() << endl;
+        result = BringUpCamera(nodeMap, config);
+        if (result < 0)
+        {
+            pCam->DeInit();
+            return result;
+        }
+        //// Acquire images
+        result = result | AcquireImages(pCam, nodeMap, nodeMapTLDevice, config);
+
+        // Deinitialize camera
+        pCam->DeInit();
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error: " << e.what() << endl;
+        result = -1;
+    }
+
+    return result;
+}
+
+// Opens every detected camera, configures them identically and acquires on one
+// thread per camera, like the AcquisitionMultipleThread sample. Each camera's
+// frames are tagged with its serial number so the streams can be stitched
+// separately or together.
+int RunMultipleCameras(CameraList& camList, const CaptureConfig& config)
+{
+    int result = 0;
+    const unsigned int numCameras = camList.GetSize();
+    vector<CameraPtr> cameras;
+    vector<CaptureConfig> cameraConfigs(numCameras, config);
+
+    try
+    {
+        for (unsigned int i = 0; i < numCameras; i++)
+        {
+            CameraPtr pCam = camList.GetByIndex(i);
+            pCam->Init();
+            cameras.push_back(pCam);
+
+            string serial = to_string(i);
+            CStringPtr ptrStringSerial = pCam->GetTLDeviceNodeMap().GetNode("DeviceSerialNumber");
+            if (IsReadable(ptrStringSerial))
+            {
+                serial = ptrStringSerial->GetValue().c_str();
+            }
+            cout << "Camera " << i << " serial number " << serial << endl;
+
+            const int err = BringUpCamera(pCam->GetNodeMap(), config);
+            if (err < 0)
+            {
+                result = -1;
+                break;
+            }
+            result = result | err;
+
+            // keep the "<prefix>-<seconds>.jpg" shape SuperStitch.m splits on
+            cameraConfigs[i].filePrefix = config.filePrefix + "_" + serial;
+            cameraConfigs[i].captureName = config.captureName + "_" + serial;
+
+            // share the worker budget rather than multiplying it
+            cameraConfigs[i].numWorkers = config.numWorkers / numCameras;
+            if (cameraConfigs[i].numWorkers == 0)
+            {
+                cameraConfigs[i].numWorkers = 1;
             }
         }
-        else 
+
+        if (result >= 0)
         {
-            CEnumerationPtr ptrAutoBright = nodeMap.GetNode("autoBrightnessMode");
-            if (!IsReadable(ptrAutoBright) ||
-                !IsWritable(ptrAutoBright))
+            vector<int> results(numCameras, 0);
+            vector<thread> threads;
+            for (unsigned int i = 0; i < numCameras; i++)
             {
-                cout << "Unable to get or set exposure time. Aborting..." << endl << endl;
-                return -1;
+                threads.push_back(thread([&, i]() {
+                    results[i] = AcquireImages(cameras[i], cameras[i]->GetNodeMap(), cameras[i]->GetTLDeviceNodeMap(),
+                                               cameraConfigs[i]);
+                }));
+            }
+            for (unsigned int i = 0; i < numCameras; i++)
+            {
+                threads[i].join();
+                result = result | results[i];
             }
-            cout << "Unable to disable automatic exposure. Expected for some models... " << endl;
-            cout << "Proceeding..." << endl;
-            result = 1;
         }
-        
-        CFloatPtr ptrExposureTime = nodeMap.GetNode("ExposureTime");
-        const double exposureTimeMax = ptrExposureTime->GetMax();
-        double exposureTimeToSet = 1000.0;
-
-        if (exposureTimeToSet > exposureTimeMax)
-        {
-            exposureTimeToSet = exposureTimeMax;
-        }
-
-        ptrExposureTime->SetValue(exposureTimeToSet);
-        //CEnumerationPtr ptrExposureAuto=nodeMap.GetNode("ExposureAuto");
-        //CEnumEntryPtr ptrExposureAutoCts=ptrExposureAuto->GetEntryByName("Continuous");
-        //ptrExposureAuto->SetIntValue(ptrExposureAutoCts->GetValue());
-        CEnumerationPtr ptrGainAuto=nodeMap.GetNode("GainAuto");
-        CEnumEntryPtr ptrGainAutoCts=ptrGainAuto->GetEntryByName("Continuous");
-        ptrGainAuto->SetIntValue(ptrGainAutoCts->GetValue());
-        //Set Metering Mode
-        CEnumerationPtr ptrMeteringMode=nodeMap.GetNode("AutoExposureMeteringMode");
-        CEnumEntryPtr ptrMeteringModePartial=ptrMeteringMode->GetEntryByName("Partial");
-        ptrMeteringMode->SetIntValue(ptrMeteringModePartial->GetValue());
-        //
-        //Goin/ExposureTime
-        //CEnumerationPtr exposurePriorityNode = nodeMap.GetNode("ExposurePriority");
-        //exposurePriorityNode->SetIntValue(1);
-        //CEnumerationPtr gainPriorityNode = nodeMap.GetNode("GainPriority");
-        //gainPriorityNode->SetIntValue(1);
-        //// Acquire images
-        result = result | AcquireImages(pCam, nodeMap, nodeMapTLDevice,numphoto);
 
-        // Deinitialize camera
-        pCam->DeInit();
+        for (size_t i = 0; i < cameras.size(); i++)
+        {
+            cameras[i]->DeInit();
+        }
     }
     catch (Spinnaker::Exception& e)
     {
@@ -224,6 +933,21 @@ int RunSingleCamera(CameraPtr pCam,int numphoto)
     return result;
 }
 
+// Runs the capture pipeline on recorded frames instead of a camera, for
+// benchmarking and regression runs on machines without one
+int RunReplay(const CaptureConfig& config, CaptureControl* control)
+{
+    cout << endl << endl << "*** REPLAY ACQUISITION ***" << endl << endl;
+
+    ReplayFrameSource source(config);
+    if (source.Load(config.replayDir) != 0)
+    {
+        return -1;
+    }
+    ClockLatch latch;
+    return AcquireFrames(source, config, latch, control);
+}
+
 int main(int argc, char *argv[]){
     //ensure file permissions
     FILE* tempFile = fopen("test.txt", "w+");
@@ -234,11 +958,55 @@ int main(int argc, char *argv[]){
     fclose(tempFile);
     remove("test.txt");
 
-    int numphoto = PHOTO_PER_SLIDE;
+    ios_base::sync_with_stdio(false);
+
+    if (argc < 2){
+        PrintCaptureUsage();
+        return -1;
+    }
+
+    // long-lived mode: camera stays initialized, captures come over a socket
+    if (strcmp(argv[1], "daemon") == 0){
+        CaptureConfig config;
+        config.numphoto = PHOTO_PER_SLIDE;
+        if (ParseCaptureArgs(argc, argv, 2, config) != 0){
+            PrintCaptureUsage();
+            return -1;
+        }
+        return RunDaemon(config);
+    }
+
+    // one-time: save the startup settings into each camera's User Set 1
+    if (strcmp(argv[1], "provision") == 0){
+        CaptureConfig config;
+        if (ParseCaptureArgs(argc, argv, 2, config) != 0){
+            PrintCaptureUsage();
+            return -1;
+        }
+        SystemPtr system = System::GetInstance();
+        CameraList camList = system->GetCameras();
+        cout << "Number of cameras detected: " << camList.GetSize() << endl << endl;
+        const int result = camList.GetSize() == 0 ? -1 : ProvisionCameras(camList, config);
+        camList.Clear();
+        system->ReleaseInstance();
+        return result;
+    }
+
+    CaptureConfig config;
+    config.numphoto = PHOTO_PER_SLIDE;
+    config.slideSize = atoi(argv[1]);
     if(strcmp(argv[1], "2")) {
-        numphoto = numphoto * 2;
+        config.numphoto = config.numphoto * 2;
+    }
+    if (ParseCaptureArgs(argc, argv, 2, config) != 0){
+        PrintCaptureUsage();
+        return -1;
     }
     
+    if (config.source == SOURCE_REPLAY){
+        return RunReplay(config);
+    }
+
     //Recieve communication
     SystemPtr system = System::GetInstance();
     CameraList camList = system->GetCameras();
@@ -246,14 +1014,20 @@ int main(int argc, char *argv[]){
     cout << "Number of cameras detected: " << numCameras << endl << endl;
     
     int result = 0;
-    if(numCameras > 0){
-        CameraPtr pCam = nullptr;
-        pCam = camList.GetByIndex(0);
-        result = result | RunSingleCamera(pCam,numphoto);
+    if(numCameras == 0){
+        return -1;
+    }
+    if(config.allCameras){
+        result = result | RunMultipleCameras(camList, config);
     }
     else{
-        return -1;
+        CameraPtr pCam = nullptr;
+        pCam = camList.GetByIndex(0);
+        result = result | RunSingleCamera(pCam, config);
     }
+
+    camList.Clear();
+    system->ReleaseInstance();
     return result;
 }
  
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include "captureConfig.h"
+#include "captureDaemon.h"
+#include "frameMetadata.h"
+#include "frameSource.h"
+
+#define PHOTO_PER_SLIDE 8500
+
+// Camera setup and acquisition entry points from runCam.cpp, shared with the
+// capture daemon. control may be null for a one-shot run.
+
+// Exposure, gain and metering defaults applied once after Init
+int ConfigureCamera(Spinnaker::GenApi::INodeMap& nodeMap);
+
+// Sensor region, binning and decimation; before BeginAcquisition only
+int ConfigureRegion(Spinnaker::GenApi::INodeMap& nodeMap, const CaptureConfig& config);
+
+// Startup settings after Init: User Set 1 if it was provisioned for config,
+// otherwise ConfigureCamera and ConfigureRegion
+int BringUpCamera(Spinnaker::GenApi::INodeMap& nodeMap, const CaptureConfig& config);
+
+// Per-run acquisition settings, then one scan's worth of frames
+int AcquireImages(Spinnaker::CameraPtr pCam, Spinnaker::GenApi::INodeMap& nodeMap,
+                  Spinnaker::GenApi::INodeMap& nodeMapTLDevice, const CaptureConfig& config,
+                  CaptureControl* control = nullptr);
+
+int AcquireFrames(FrameSource& source, const CaptureConfig& config, const ClockLatch& latch,
+                  CaptureControl* control = nullptr);
+
+int RunReplay(const CaptureConfig& config, CaptureControl* control = nullptr);
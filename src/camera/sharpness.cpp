@@ -0,0 +1,210 @@
+#include "sharpness.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHARPNESS_X86 1
+#endif
+using namespace std;
+
+// Largest decimation whose column sums still fit the uint16 accumulators
+#define SHARPNESS_MAX_DECIMATION 16
+// AVX2 Laplacian steps between spills of the 32-bit square sums; each step
+// adds at most 2 * 1020^2 per lane
+#define SHARPNESS_FLUSH_STEPS 512
+
+SharpnessScorer::SharpnessScorer()
+    : m_decimation(4),
+      m_avx2(false)
+{
+#ifdef SHARPNESS_X86
+    m_avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+void SharpnessScorer::Init(unsigned int decimation)
+{
+    if (decimation == 0)
+    {
+        decimation = 1;
+    }
+    if (decimation > SHARPNESS_MAX_DECIMATION)
+    {
+        decimation = SHARPNESS_MAX_DECIMATION;
+    }
+    m_decimation = decimation;
+}
+
+void SharpnessScorer::Reserve(size_t width, size_t height)
+{
+    if (m_decimation > 1)
+    {
+        m_small.reserve((width / m_decimation) * (height / m_decimation));
+        m_rowSums.reserve(width);
+    }
+}
+
+// Sums of the Laplacian and its square over the interior of a frame
+struct LaplacianSums
+{
+    int64_t sum;
+    int64_t squares;
+};
+
+#ifdef SHARPNESS_X86
+// Adds rows rows of 8-bit pixels column-wise into sums, 16 columns at a time;
+// returns the first column left for the scalar loop
+__attribute__((target("avx2"))) static size_t ColumnSumsAvx2(const uint8_t* pixels, size_t stride,
+                                                             unsigned int rows, size_t width, uint16_t* sums)
+{
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16)
+    {
+        __m256i total = _mm256_setzero_si256();
+        for (unsigned int r = 0; r < rows; r++)
+        {
+            const __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + r * stride + x));
+            total = _mm256_add_epi16(total, _mm256_cvtepu8_epi16(row));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + x), total);
+    }
+    return x;
+}
+
+__attribute__((target("avx2"))) static inline __m256i LoadWidened(const uint8_t* p)
+{
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+__attribute__((target("avx2"))) static int64_t SumLanes(__m256i v)
+{
+    int32_t lanes[8];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), v);
+    int64_t total = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        total += lanes[i];
+    }
+    return total;
+}
+
+// One interior row of the Laplacian, 16 pixels per step; returns the first
+// column left for the scalar loop
+__attribute__((target("avx2"))) static size_t LaplacianRowAvx2(const uint8_t* row, size_t stride, size_t width,
+                                                               LaplacianSums& sums)
+{
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    __m256i squares = _mm256_setzero_si256();
+    unsigned int steps = 0;
+    size_t x = 1;
+    for (; x + 17 <= width; x += 16)
+    {
+        const uint8_t* p = row + x;
+        // 4c - left - right - up - down stays within +/-1020, so int16 is enough
+        __m256i laplacian = _mm256_slli_epi16(LoadWidened(p), 2);
+        laplacian = _mm256_sub_epi16(laplacian, LoadWidened(p - 1));
+        laplacian = _mm256_sub_epi16(laplacian, LoadWidened(p + 1));
+        laplacian = _mm256_sub_epi16(laplacian, LoadWidened(p - stride));
+        laplacian = _mm256_sub_epi16(laplacian, LoadWidened(p + stride));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(laplacian, ones));
+        squares = _mm256_add_epi32(squares, _mm256_madd_epi16(laplacian, laplacian));
+        if (++steps == SHARPNESS_FLUSH_STEPS)
+        {
+            sums.sum += SumLanes(sum);
+            sums.squares += SumLanes(squares);
+            sum = _mm256_setzero_si256();
+            squares = _mm256_setzero_si256();
+            steps = 0;
+        }
+    }
+    sums.sum += SumLanes(sum);
+    sums.squares += SumLanes(squares);
+    return x;
+}
+#endif
+
+static void LaplacianSumsOf(const uint8_t* pixels, size_t width, size_t height, size_t stride, bool avx2,
+                            LaplacianSums& sums)
+{
+    sums.sum = 0;
+    sums.squares = 0;
+    for (size_t y = 1; y + 1 < height; y++)
+    {
+        const uint8_t* row = pixels + y * stride;
+        size_t x = 1;
+#ifdef SHARPNESS_X86
+        if (avx2)
+        {
+            x = LaplacianRowAvx2(row, stride, width, sums);
+        }
+#endif
+        for (; x + 1 < width; x++)
+        {
+            const int laplacian = 4 * row[x] - row[x - 1] - row[x + 1] - row[x - stride] - row[x + stride];
+            sums.sum += laplacian;
+            sums.squares += laplacian * laplacian;
+        }
+    }
+}
+
+double SharpnessScorer::Score(const uint8_t* pixels, size_t width, size_t height, size_t stride)
+{
+    const uint8_t* frame = pixels;
+    size_t frameWidth = width;
+    size_t frameHeight = height;
+    size_t frameStride = stride;
+
+    if (m_decimation > 1)
+    {
+        const unsigned int d = m_decimation;
+        frameWidth = width / d;
+        frameHeight = height / d;
+        frameStride = frameWidth;
+        m_small.resize(frameWidth * frameHeight);
+        m_rowSums.resize(width);
+        const unsigned int area = d * d;
+
+        for (size_t y = 0; y < frameHeight; y++)
+        {
+            const uint8_t* block = pixels + y * d * stride;
+            size_t x = 0;
+#ifdef SHARPNESS_X86
+            if (m_avx2)
+            {
+                x = ColumnSumsAvx2(block, stride, d, width, m_rowSums.data());
+            }
+#endif
+            for (; x < width; x++)
+            {
+                unsigned int total = 0;
+                for (unsigned int r = 0; r < d; r++)
+                {
+                    total += block[r * stride + x];
+                }
+                m_rowSums[x] = (uint16_t)total;
+            }
+
+            uint8_t* out = m_small.data() + y * frameWidth;
+            for (size_t ox = 0; ox < frameWidth; ox++)
+            {
+                unsigned int total = 0;
+                for (unsigned int k = 0; k < d; k++)
+                {
+                    total += m_rowSums[ox * d + k];
+                }
+                out[ox] = (uint8_t)((total + area / 2) / area);
+            }
+        }
+        frame = m_small.data();
+    }
+
+    if (frameWidth < 3 || frameHeight < 3)
+    {
+        return 0.0;
+    }
+
+    LaplacianSums sums;
+    LaplacianSumsOf(frame, frameWidth, frameHeight, frameStride, m_avx2, sums);
+    const double count = (double)(frameWidth - 2) * (double)(frameHeight - 2);
+    const double mean = sums.sum / count;
+    return sums.squares / count - mean * mean;
+}
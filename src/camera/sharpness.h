@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Focus measure for 8-bit frames: the variance of the 4-neighbour Laplacian,
+// taken on a copy box-averaged by decimation x decimation. Blur from stage
+// motion or defocus flattens edges and pulls the score down; averaging first
+// keeps sensor noise from dominating it and makes scoring cheap. Scores
+// depend on the decimation and the scene, so thresholds are best picked from
+// the sharpness column of a test scan's frames.csv.
+//
+// The downsample and Laplacian loops use AVX2 when the CPU has it and give
+// the same integer sums as the scalar fallback. One instance per worker
+// thread; it keeps its scratch buffer between frames.
+class SharpnessScorer
+{
+public:
+    SharpnessScorer();
+
+    // decimation of 1 scores the frame at full resolution
+    void Init(unsigned int decimation);
+
+    // Sizes the scratch buffer for width x height frames so scoring never
+    // allocates
+    void Reserve(size_t width, size_t height);
+
+    // stride bytes per row. Frames under 3x3 after decimation score 0.
+    double Score(const uint8_t* pixels, size_t width, size_t height, size_t stride);
+
+private:
+    unsigned int m_decimation;
+    bool m_avx2;
+    std::vector<uint8_t> m_small;     // decimated frame
+    std::vector<uint16_t> m_rowSums;  // column sums of one block row
+};
@@ -0,0 +1,98 @@
+#include "simTrigger.h"
+#include "frameMetadata.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <thread>
+using namespace std;
+
+// Edges are at most a few hundred per second, so polling is plenty
+#define SIM_TRIGGER_POLL_US 100
+
+SimTriggerLine::SimTriggerLine()
+    : m_bank(nullptr),
+      m_pin(0),
+      m_consumed(0)
+{
+}
+
+SimTriggerLine::~SimTriggerLine()
+{
+    if (m_bank != nullptr)
+    {
+        munmap(m_bank, sizeof(SimGpioBank));
+    }
+}
+
+int SimTriggerLine::Open(int pin)
+{
+    if (pin < 0 || pin >= SIM_GPIO_PINS)
+    {
+        cout << "Simulated trigger pin " << pin << " out of range" << endl;
+        return -1;
+    }
+
+    const int fd = open(SIM_GPIO_BANK_PATH, O_RDWR | O_CREAT, 0666);
+    if (fd < 0)
+    {
+        cout << "Unable to open " << SIM_GPIO_BANK_PATH << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    // both sides size the file, so either may start first
+    if (ftruncate(fd, sizeof(SimGpioBank)) != 0)
+    {
+        cout << "Unable to size " << SIM_GPIO_BANK_PATH << ": " << strerror(errno) << endl;
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(nullptr, sizeof(SimGpioBank), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        cout << "Unable to map " << SIM_GPIO_BANK_PATH << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    m_bank = static_cast<SimGpioBank*>(map);
+    m_pin = pin;
+    Arm();
+    cout << "Waiting for simulated triggers on GPIO " << pin << " (" << SIM_GPIO_BANK_PATH << ")" << endl;
+    return 0;
+}
+
+void SimTriggerLine::Arm()
+{
+    if (m_bank != nullptr)
+    {
+        m_consumed = __atomic_load_n(&m_bank->risingEdges[m_pin], __ATOMIC_ACQUIRE);
+    }
+}
+
+bool SimTriggerLine::WaitForEdge(uint64_t timeoutMs)
+{
+    if (m_bank == nullptr)
+    {
+        return false;
+    }
+
+    const int64_t deadline = HostMonotonicNs() + (int64_t)timeoutMs * 1000000;
+    while (true)
+    {
+        // counters wrap together, so the difference stays right
+        const uint32_t edges = __atomic_load_n(&m_bank->risingEdges[m_pin], __ATOMIC_ACQUIRE);
+        if (edges - m_consumed > 0)
+        {
+            m_consumed++;
+            return true;
+        }
+        if (HostMonotonicNs() >= deadline)
+        {
+            return false;
+        }
+        this_thread::sleep_for(chrono::microseconds(SIM_TRIGGER_POLL_US));
+    }
+}
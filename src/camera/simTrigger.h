@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// Camera end of the simulated GPIO pair. The stage controller built with
+// -DSIM_GPIO (stageTranslationFiles/simGPIO.h) keeps pin levels and rising
+// edge counts in a shared file; the replay source reads the trigger pin's edge
+// count from it instead of a camera input line. Layout must match SIM_GPIO_BANK.
+#define SIM_GPIO_BANK_PATH "/tmp/superstitch_sim_gpio"
+#define SIM_GPIO_PINS 128 // NUM_BBB_PINS
+
+struct SimGpioBank
+{
+    uint32_t value[SIM_GPIO_PINS];
+    uint32_t risingEdges[SIM_GPIO_PINS];
+};
+
+class SimTriggerLine
+{
+public:
+    SimTriggerLine();
+    ~SimTriggerLine();
+
+    // Maps the bank, creating it if the stage controller has not yet
+    int Open(int pin);
+
+    // Ignores edges from before this call, e.g. a previous scan
+    void Arm();
+
+    // Consumes one rising edge, waiting up to timeoutMs for it
+    bool WaitForEdge(uint64_t timeoutMs);
+
+private:
+    SimTriggerLine(const SimTriggerLine&);
+    SimTriggerLine& operator=(const SimTriggerLine&);
+
+    SimGpioBank* m_bank;
+    int m_pin;
+    uint32_t m_consumed;
+};
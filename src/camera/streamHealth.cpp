@@ -0,0 +1,174 @@
+#include "streamHealth.h"
+#include <iostream>
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace Spinnaker::GenICam;
+using namespace std;
+
+#define MAX_REPORTED_GAPS 16
+
+int ConfigureStreamBuffers(CameraPtr pCam, const CaptureConfig& config)
+{
+    INodeMap& sNodeMap = pCam->GetTLStreamNodeMap();
+
+    if (!config.bufferHandling.empty())
+    {
+        CEnumerationPtr ptrHandlingMode = sNodeMap.GetNode("StreamBufferHandlingMode");
+        if (!IsReadable(ptrHandlingMode) || !IsWritable(ptrHandlingMode))
+        {
+            cout << "Unable to set Buffer Handling mode (node retrieval). Aborting..." << endl << endl;
+            return -1;
+        }
+        CEnumEntryPtr ptrHandlingModeEntry = ptrHandlingMode->GetEntryByName(config.bufferHandling.c_str());
+        if (!IsReadable(ptrHandlingModeEntry))
+        {
+            cout << "Buffer Handling mode " << config.bufferHandling << " not supported. Aborting..." << endl << endl;
+            return -1;
+        }
+        ptrHandlingMode->SetIntValue(ptrHandlingModeEntry->GetValue());
+        cout << "Buffer Handling mode set to " << config.bufferHandling << "..." << endl;
+    }
+
+    if (config.streamBuffers > 0)
+    {
+        if (config.userBuffers > 0)
+        {
+            // with user buffers the count is however many we registered
+            cout << "--stream-buffers ignored, using " << config.userBuffers << " user buffers" << endl;
+            return 0;
+        }
+
+        CEnumerationPtr ptrStreamBufferCountMode = sNodeMap.GetNode("StreamBufferCountMode");
+        if (!IsReadable(ptrStreamBufferCountMode) || !IsWritable(ptrStreamBufferCountMode))
+        {
+            cout << "Unable to get or set Buffer Count Mode (node retrieval). Aborting..." << endl << endl;
+            return -1;
+        }
+        CEnumEntryPtr ptrStreamBufferCountModeManual = ptrStreamBufferCountMode->GetEntryByName("Manual");
+        if (!IsReadable(ptrStreamBufferCountModeManual))
+        {
+            cout << "Unable to get Buffer Count Mode entry (Entry retrieval). Aborting..." << endl << endl;
+            return -1;
+        }
+        ptrStreamBufferCountMode->SetIntValue(ptrStreamBufferCountModeManual->GetValue());
+
+        CIntegerPtr ptrBufferCount = sNodeMap.GetNode("StreamBufferCountManual");
+        if (!IsReadable(ptrBufferCount) || !IsWritable(ptrBufferCount))
+        {
+            cout << "Unable to get or set Buffer Count (Integer node retrieval). Aborting..." << endl << endl;
+            return -1;
+        }
+
+        int64_t count = (int64_t)config.streamBuffers;
+        if (count > ptrBufferCount->GetMax())
+        {
+            cout << "Buffer count " << count << " above maximum, clamping to " << ptrBufferCount->GetMax() << endl;
+            count = ptrBufferCount->GetMax();
+        }
+        ptrBufferCount->SetValue(count);
+        cout << "Buffer count set to " << ptrBufferCount->GetValue() << "..." << endl;
+    }
+
+    return 0;
+}
+
+FrameIdTracker::FrameIdTracker()
+    : m_first(true),
+      m_last(0),
+      m_seen(0),
+      m_missing(0),
+      m_outOfOrder(0)
+{
+    m_gaps.reserve(MAX_REPORTED_GAPS);
+}
+
+void FrameIdTracker::Record(int64_t frameId)
+{
+    m_seen++;
+    if (m_first)
+    {
+        m_first = false;
+        m_last = frameId;
+        return;
+    }
+
+    if (frameId <= m_last)
+    {
+        m_outOfOrder++;
+        return;
+    }
+
+    if (frameId > m_last + 1)
+    {
+        const int64_t missing = frameId - m_last - 1;
+        m_missing += (uint64_t)missing;
+        if (m_gaps.size() < MAX_REPORTED_GAPS)
+        {
+            FrameGap gap;
+            gap.after = m_last;
+            gap.missing = missing;
+            m_gaps.push_back(gap);
+        }
+    }
+    m_last = frameId;
+}
+
+void FrameIdTracker::Report() const
+{
+    cout << "FrameIDs seen: " << m_seen << ", missing: " << m_missing << ", out of order: " << m_outOfOrder << endl;
+    for (size_t i = 0; i < m_gaps.size(); i++)
+    {
+        cout << "\t" << m_gaps[i].missing << " frame(s) missing after FrameID " << m_gaps[i].after << endl;
+    }
+}
+
+static bool ReadCounter(INodeMap& sNodeMap, const char* name, int64_t& value)
+{
+    CIntegerPtr ptrCounter = sNodeMap.GetNode(name);
+    if (!IsReadable(ptrCounter))
+    {
+        return false;
+    }
+    value = ptrCounter->GetValue();
+    cout << "\t" << name << ": " << value << endl;
+    return true;
+}
+
+int64_t ReportStreamStatistics(CameraPtr pCam)
+{
+    INodeMap& sNodeMap = pCam->GetTLStreamNodeMap();
+    int64_t value = 0;
+    int64_t lost = 0;
+    bool readable = false;
+
+    cout << "Stream statistics:" << endl;
+    ReadCounter(sNodeMap, "StreamDeliveredFrameCount", value);
+    ReadCounter(sNodeMap, "StreamIncompleteFrameCount", value);
+    if (ReadCounter(sNodeMap, "StreamDroppedFrameCount", value))
+    {
+        lost += value;
+        readable = true;
+    }
+    if (ReadCounter(sNodeMap, "StreamLostFrameCount", value))
+    {
+        lost += value;
+        readable = true;
+    }
+    ReadCounter(sNodeMap, "StreamMissedPacketCount", value);
+
+    if (!readable)
+    {
+        cout << "Unable to determine the dropped frame count from the nodemap" << endl;
+        return -1;
+    }
+    return lost;
+}
+
+void ReadStreamCounters(CameraPtr pCam, int64_t& dropped, int64_t& lost)
+{
+    INodeMap& sNodeMap = pCam->GetTLStreamNodeMap();
+    CIntegerPtr ptrDropped = sNodeMap.GetNode("StreamDroppedFrameCount");
+    CIntegerPtr ptrLost = sNodeMap.GetNode("StreamLostFrameCount");
+    dropped = IsReadable(ptrDropped) ? ptrDropped->GetValue() : -1;
+    lost = IsReadable(ptrLost) ? ptrLost->GetValue() : -1;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include "captureConfig.h"
+#include <stdint.h>
+#include <vector>
+
+// Applies StreamBufferHandlingMode and StreamBufferCountManual from the config
+// through the TL stream nodemap, as the BufferHandling sample does. Settings
+// left at their defaults are not touched.
+int ConfigureStreamBuffers(Spinnaker::CameraPtr pCam, const CaptureConfig& config);
+
+// Watches FrameIDs on the grab thread for frames the camera sent but we never saw
+struct FrameGap
+{
+    int64_t after; // last FrameID seen before the gap
+    int64_t missing;
+};
+
+class FrameIdTracker
+{
+public:
+    FrameIdTracker();
+
+    void Record(int64_t frameId);
+    void Report() const;
+
+    uint64_t GetMissing() const { return m_missing; }
+
+private:
+    bool m_first;
+    int64_t m_last;
+    uint64_t m_seen;
+    uint64_t m_missing;
+    uint64_t m_outOfOrder;
+    std::vector<FrameGap> m_gaps; // first few gaps, for the report
+};
+
+// Prints the stream's delivered/dropped/lost/incomplete counters and returns
+// dropped + lost, or -1 if the counters cannot be read
+int64_t ReportStreamStatistics(Spinnaker::CameraPtr pCam);
+
+// Reads StreamDroppedFrameCount and StreamLostFrameCount without printing, for
+// periodic polling during acquisition. Counters that cannot be read are -1.
+void ReadStreamCounters(Spinnaker::CameraPtr pCam, int64_t& dropped, int64_t& lost);
@@ -0,0 +1,239 @@
+#include "telemetry.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+using namespace std;
+
+static const char* LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT] = {"grab_to_dequeue", "dequeue_to_converted",
+                                                              "converted_to_encoded", "encoded_to_disk"};
+
+Log2Histogram::Log2Histogram()
+{
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        m_buckets[i].store(0, memory_order_relaxed);
+    }
+    m_count.store(0, memory_order_relaxed);
+    m_sum.store(0, memory_order_relaxed);
+}
+
+void Log2Histogram::Record(uint64_t value)
+{
+    int bucket = 0;
+    while (bucket < BUCKETS - 1 && value > (1ULL << bucket))
+    {
+        bucket++;
+    }
+    m_buckets[bucket].fetch_add(1, memory_order_relaxed);
+    m_sum.fetch_add(value, memory_order_relaxed);
+    m_count.fetch_add(1, memory_order_relaxed);
+}
+
+void Log2Histogram::Snapshot(uint64_t* buckets, uint64_t& count, uint64_t& sum) const
+{
+    for (int i = 0; i < BUCKETS; i++)
+    {
+        buckets[i] = m_buckets[i].load(memory_order_relaxed);
+    }
+    count = m_count.load(memory_order_relaxed);
+    sum = m_sum.load(memory_order_relaxed);
+}
+
+CaptureTelemetry::CaptureTelemetry()
+    : m_interval(0.0),
+      m_stopping(false)
+{
+    for (int i = 0; i < MAX_IMAGE_STATUS + 2; i++)
+    {
+        m_incomplete[i].store(0, memory_order_relaxed);
+    }
+    m_streamDropped.store(-1, memory_order_relaxed);
+    m_streamLost.store(-1, memory_order_relaxed);
+}
+
+CaptureTelemetry::~CaptureTelemetry()
+{
+    StopExport();
+}
+
+void CaptureTelemetry::Init(unsigned int numWorkers, const string& label)
+{
+    m_label = label;
+    m_threads.reset(new CacheAlignedArray<ThreadTelemetry>(numWorkers + 1));
+}
+
+void CaptureTelemetry::RecordLatency(unsigned int slot, LatencyStage stage, int64_t startNs, int64_t endNs)
+{
+    if (!m_threads || slot >= m_threads->size() || startNs == 0 || endNs < startNs)
+    {
+        return;
+    }
+    (*m_threads)[slot].latencyUs[stage].Record((uint64_t)((endNs - startNs) / 1000));
+}
+
+void CaptureTelemetry::RecordQueueDepth(size_t depth)
+{
+    m_queueDepth.Record(depth);
+}
+
+void CaptureTelemetry::RecordIncomplete(int imageStatus)
+{
+    if (imageStatus < -1 || imageStatus > MAX_IMAGE_STATUS)
+    {
+        imageStatus = -1;
+    }
+    m_incomplete[imageStatus + 1].fetch_add(1, memory_order_relaxed);
+}
+
+void CaptureTelemetry::SetStreamCounters(int64_t dropped, int64_t lost)
+{
+    m_streamDropped.store(dropped, memory_order_relaxed);
+    m_streamLost.store(lost, memory_order_relaxed);
+}
+
+int CaptureTelemetry::StartExport(const string& path, double intervalSeconds)
+{
+    StopExport();
+    m_path = path;
+    m_interval = intervalSeconds > 0 ? intervalSeconds : 5.0;
+    m_stopping = false;
+    m_exporter = thread(&CaptureTelemetry::ExportLoop, this);
+    cout << "Writing metrics to " << m_path << " every " << m_interval << " s..." << endl;
+    return 0;
+}
+
+void CaptureTelemetry::StopExport()
+{
+    if (!m_exporter.joinable())
+    {
+        return;
+    }
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_exporter.join();
+
+    // final totals for the whole run
+    WriteMetrics(m_path);
+}
+
+void CaptureTelemetry::ExportLoop()
+{
+    const chrono::microseconds interval((int64_t)(m_interval * 1000000.0));
+    unique_lock<mutex> lock(m_mutex);
+    while (!m_stopping)
+    {
+        if (m_wake.wait_for(lock, interval, [this] { return m_stopping; }))
+        {
+            break;
+        }
+        lock.unlock();
+        WriteMetrics(m_path);
+        lock.lock();
+    }
+}
+
+// Writes one histogram series, merging the given per-thread histograms.
+// Values are multiplied by scale into the exported unit.
+static void WriteHistogram(FILE* file, const char* name, const string& labels,
+                           const vector<const Log2Histogram*>& histograms, double scale)
+{
+    uint64_t total[Log2Histogram::BUCKETS] = {0};
+    uint64_t totalSum = 0;
+    for (size_t h = 0; h < histograms.size(); h++)
+    {
+        uint64_t buckets[Log2Histogram::BUCKETS];
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        histograms[h]->Snapshot(buckets, count, sum);
+        for (int i = 0; i < Log2Histogram::BUCKETS; i++)
+        {
+            total[i] += buckets[i];
+        }
+        totalSum += sum;
+    }
+
+    // buckets are read one at a time while writers run, so the count is taken
+    // from them rather than the separately read total to keep the series consistent
+    uint64_t cumulative = 0;
+    for (int i = 0; i < Log2Histogram::BUCKETS - 1; i++)
+    {
+        cumulative += total[i];
+        fprintf(file, "%s_bucket{%s,le=\"%g\"} %llu\n", name, labels.c_str(), (double)(1ULL << i) * scale,
+                (unsigned long long)cumulative);
+    }
+    cumulative += total[Log2Histogram::BUCKETS - 1];
+    fprintf(file, "%s_bucket{%s,le=\"+Inf\"} %llu\n", name, labels.c_str(), (unsigned long long)cumulative);
+    fprintf(file, "%s_sum{%s} %g\n", name, labels.c_str(), (double)totalSum * scale);
+    fprintf(file, "%s_count{%s} %llu\n", name, labels.c_str(), (unsigned long long)cumulative);
+}
+
+int CaptureTelemetry::WriteMetrics(const string& path)
+{
+    // write aside and rename so a scraper never reads a half-written file
+    const string tmpPath = path + ".tmp";
+    FILE* file = fopen(tmpPath.c_str(), "w");
+    if (file == nullptr)
+    {
+        cout << "Unable to write metrics to " << tmpPath << ": " << strerror(errno) << endl;
+        return -1;
+    }
+
+    const string capture = "capture=\"" + m_label + "\"";
+
+    fprintf(file, "# HELP superstitch_frame_latency_seconds Per-frame latency of each capture pipeline stage.\n");
+    fprintf(file, "# TYPE superstitch_frame_latency_seconds histogram\n");
+    for (int stage = 0; stage < LATENCY_STAGE_COUNT; stage++)
+    {
+        vector<const Log2Histogram*> perThread;
+        for (size_t t = 0; m_threads && t < m_threads->size(); t++)
+        {
+            perThread.push_back(&(*m_threads)[t].latencyUs[stage]);
+        }
+        WriteHistogram(file, "superstitch_frame_latency_seconds",
+                       capture + ",stage=\"" + LATENCY_STAGE_NAMES[stage] + "\"", perThread, 1e-6);
+    }
+
+    fprintf(file, "# HELP superstitch_queue_depth Frames waiting for a worker, sampled at each submit.\n");
+    fprintf(file, "# TYPE superstitch_queue_depth histogram\n");
+    WriteHistogram(file, "superstitch_queue_depth", capture, vector<const Log2Histogram*>(1, &m_queueDepth), 1.0);
+
+    fprintf(file, "# HELP superstitch_incomplete_images_total Incomplete images by Spinnaker ImageStatus code.\n");
+    fprintf(file, "# TYPE superstitch_incomplete_images_total counter\n");
+    for (int i = 0; i < MAX_IMAGE_STATUS + 2; i++)
+    {
+        const uint64_t count = m_incomplete[i].load(memory_order_relaxed);
+        if (count > 0)
+        {
+            fprintf(file, "superstitch_incomplete_images_total{%s,status=\"%d\"} %llu\n", capture.c_str(), i - 1,
+                    (unsigned long long)count);
+        }
+    }
+
+    // -1 until the stream nodemap has been read once
+    const int64_t dropped = m_streamDropped.load(memory_order_relaxed);
+    const int64_t lost = m_streamLost.load(memory_order_relaxed);
+    fprintf(file, "# HELP superstitch_stream_dropped_frames StreamDroppedFrameCount from the TL stream nodemap.\n");
+    fprintf(file, "# TYPE superstitch_stream_dropped_frames gauge\n");
+    if (dropped >= 0)
+    {
+        fprintf(file, "superstitch_stream_dropped_frames{%s} %lld\n", capture.c_str(), (long long)dropped);
+    }
+    fprintf(file, "# HELP superstitch_stream_lost_frames StreamLostFrameCount from the TL stream nodemap.\n");
+    fprintf(file, "# TYPE superstitch_stream_lost_frames gauge\n");
+    if (lost >= 0)
+    {
+        fprintf(file, "superstitch_stream_lost_frames{%s} %lld\n", capture.c_str(), (long long)lost);
+    }
+
+    if (fclose(file) != 0 || rename(tmpPath.c_str(), path.c_str()) != 0)
+    {
+        cout << "Unable to write metrics to " << path << ": " << strerror(errno) << endl;
+        return -1;
+    }
+    return 0;
+}
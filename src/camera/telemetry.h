@@ -0,0 +1,100 @@
+#pragma once
+
+#include "frameQueue.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Per-frame latencies measured through the pipeline
+enum LatencyStage
+{
+    LATENCY_GRAB_TO_DEQUEUE = 0,      // GetNextImage returned -> a worker picked the frame up
+    LATENCY_DEQUEUE_TO_CONVERTED = 1, // pixels in the output format (decompressed/converted)
+    LATENCY_CONVERTED_TO_ENCODED = 2, // JPEG encode; not recorded for raw/container output
+    LATENCY_ENCODED_TO_DISK = 3,      // file or container write returned
+    LATENCY_STAGE_COUNT = 4
+};
+
+// Power-of-two buckets: bucket i counts values <= 2^i, the last one is +Inf.
+// Each instance has a single writer thread, so Record never contends; the
+// exporter reads the relaxed atomics from another thread.
+class Log2Histogram
+{
+public:
+    static const int BUCKETS = 32;
+
+    Log2Histogram();
+
+    void Record(uint64_t value);
+
+    // Copies per-bucket (not cumulative) counts and the running sum
+    void Snapshot(uint64_t* buckets, uint64_t& count, uint64_t& sum) const;
+
+private:
+    std::atomic<uint64_t> m_buckets[BUCKETS];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+};
+
+// One writer's histograms, padded so threads never share a cache line. Held in
+// a CacheAlignedArray since std::vector ignores the alignment before C++17.
+struct alignas(FRAME_QUEUE_CACHE_LINE) ThreadTelemetry
+{
+    Log2Histogram latencyUs[LATENCY_STAGE_COUNT];
+};
+
+// Counters for one acquisition, written as Prometheus text to a metrics file
+// every interval and once more when export stops. Slot 0 belongs to the grab
+// thread and worker i records into slot i + 1.
+class CaptureTelemetry
+{
+public:
+    // incomplete images are counted per ImageStatus code, -1 to MAX_IMAGE_STATUS
+    static const int MAX_IMAGE_STATUS = 14;
+
+    CaptureTelemetry();
+    ~CaptureTelemetry();
+
+    void Init(unsigned int numWorkers, const std::string& label);
+
+    void RecordLatency(unsigned int slot, LatencyStage stage, int64_t startNs, int64_t endNs);
+
+    // Grab thread side
+    void RecordQueueDepth(size_t depth);
+    void RecordIncomplete(int imageStatus);
+    void SetStreamCounters(int64_t dropped, int64_t lost);
+
+    // Writes path every intervalSeconds from a background thread
+    int StartExport(const std::string& path, double intervalSeconds);
+    void StopExport();
+
+    int WriteMetrics(const std::string& path);
+
+private:
+    CaptureTelemetry(const CaptureTelemetry&);
+    CaptureTelemetry& operator=(const CaptureTelemetry&);
+
+    void ExportLoop();
+
+    std::string m_label;
+    std::unique_ptr<CacheAlignedArray<ThreadTelemetry> > m_threads; // sized by Init
+
+    // grab thread only
+    Log2Histogram m_queueDepth;
+    std::atomic<uint64_t> m_incomplete[MAX_IMAGE_STATUS + 2];
+    std::atomic<int64_t> m_streamDropped;
+    std::atomic<int64_t> m_streamLost;
+
+    std::string m_path;
+    double m_interval;
+    std::thread m_exporter;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stopping;
+};
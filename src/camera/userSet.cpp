@@ -0,0 +1,184 @@
+#include "userSet.h"
+#include <stdio.h>
+#include <iostream>
+#include <sstream>
+using namespace Spinnaker;
+using namespace Spinnaker::GenApi;
+using namespace Spinnaker::GenICam;
+using namespace std;
+
+// Keep the stamp short; some models limit DeviceUserID to 16 characters
+#define USER_SET_STAMP_PREFIX "camrun-"
+
+uint32_t UserSetHash(const CaptureConfig& config)
+{
+    // everything ConfigureCamera and ConfigureRegion decide from the config,
+    // plus the layout version for what ConfigureCamera hard-codes
+    ostringstream settings;
+    settings << "layout=" << USER_SET_LAYOUT << " roi=" << config.roiWidth << "x" << config.roiHeight << "+"
+             << config.roiOffsetX << "+" << config.roiOffsetY << " binning=" << config.binning
+             << " decimation=" << config.decimation;
+
+    // FNV-1a
+    const string text = settings.str();
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        hash ^= (uint8_t)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+string UserSetStamp(const CaptureConfig& config)
+{
+    char stamp[32];
+    snprintf(stamp, sizeof(stamp), USER_SET_STAMP_PREFIX "%08x", (unsigned int)UserSetHash(config));
+    return stamp;
+}
+
+// Points UserSetSelector at the named set and returns its entry value, or -1
+static int64_t SelectUserSet(INodeMap& nodeMap, const char* name)
+{
+    CEnumerationPtr ptrUserSetSelector = nodeMap.GetNode("UserSetSelector");
+    if (!IsReadable(ptrUserSetSelector) || !IsWritable(ptrUserSetSelector))
+    {
+        cout << "Unable to set User Set Selector to " << name << " (node retrieval). Aborting..." << endl;
+        return -1;
+    }
+    CEnumEntryPtr ptrUserSet = ptrUserSetSelector->GetEntryByName(name);
+    if (!IsReadable(ptrUserSet))
+    {
+        cout << "Unable to set User Set Selector to " << name << " (enum entry retrieval). Aborting..." << endl;
+        return -1;
+    }
+    const int64_t userSet = ptrUserSet->GetValue();
+    ptrUserSetSelector->SetIntValue(userSet);
+    return userSet;
+}
+
+int LoadDefaultUserSet(INodeMap& nodeMap)
+{
+    try
+    {
+        if (SelectUserSet(nodeMap, "Default") < 0)
+        {
+            return -1;
+        }
+        CCommandPtr ptrUserSetLoad = nodeMap.GetNode("UserSetLoad");
+        if (!IsWritable(ptrUserSetLoad))
+        {
+            cout << "Unable to load the Default user set (node retrieval). Aborting..." << endl;
+            return -1;
+        }
+        ptrUserSetLoad->Execute();
+        cout << "Loaded the Default user set..." << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error loading the Default user set: " << e.what() << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int SaveUserSet(INodeMap& nodeMap, const CaptureConfig& config)
+{
+    try
+    {
+        const int64_t userSet1 = SelectUserSet(nodeMap, "UserSet1");
+        if (userSet1 < 0)
+        {
+            return -1;
+        }
+
+        // the camera comes up with these settings after a power cycle too
+        CEnumerationPtr ptrUserSetDefault = nodeMap.GetNode("UserSetDefault");
+        if (!IsWritable(ptrUserSetDefault))
+        {
+            cout << "Unable to set User Set Default to User Set 1 (node retrieval). Aborting..." << endl;
+            return -1;
+        }
+        ptrUserSetDefault->SetIntValue(userSet1);
+
+        CEnumerationPtr ptrAcquisitionMode = nodeMap.GetNode("AcquisitionMode");
+        if (!IsReadable(ptrAcquisitionMode) || !IsWritable(ptrAcquisitionMode))
+        {
+            cout << "Unable to set acquisition mode to continuous (node retrieval). Aborting..." << endl;
+            return -1;
+        }
+        CEnumEntryPtr ptrAcquisitionModeContinuous = ptrAcquisitionMode->GetEntryByName("Continuous");
+        if (!IsReadable(ptrAcquisitionModeContinuous))
+        {
+            cout << "Unable to set acquisition mode to continuous (enum entry retrieval). Aborting..." << endl;
+            return -1;
+        }
+        ptrAcquisitionMode->SetIntValue(ptrAcquisitionModeContinuous->GetValue());
+
+        CCommandPtr ptrUserSetSave = nodeMap.GetNode("UserSetSave");
+        if (!IsWritable(ptrUserSetSave))
+        {
+            cout << "Unable to save settings to User Set 1. Aborting..." << endl;
+            return -1;
+        }
+        ptrUserSetSave->Execute();
+
+        // DeviceUserID is kept in its own non-volatile register, not in the set
+        const string stamp = UserSetStamp(config);
+        CStringPtr ptrDeviceUserId = nodeMap.GetNode("DeviceUserID");
+        if (!IsWritable(ptrDeviceUserId))
+        {
+            cout << "Unable to write DeviceUserID; settings saved but runs will not load them. Aborting..." << endl;
+            return -1;
+        }
+        ptrDeviceUserId->SetValue(stamp.c_str());
+        cout << "Settings saved to User Set 1 as " << stamp << "..." << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error saving user set 1: " << e.what() << endl;
+        return -1;
+    }
+    return 0;
+}
+
+int LoadUserSet(INodeMap& nodeMap, const CaptureConfig& config)
+{
+    try
+    {
+        const string stamp = UserSetStamp(config);
+        CStringPtr ptrDeviceUserId = nodeMap.GetNode("DeviceUserID");
+        if (!IsReadable(ptrDeviceUserId))
+        {
+            return 1;
+        }
+        const string current = ptrDeviceUserId->GetValue().c_str();
+        if (current != stamp)
+        {
+            const bool otherSettings =
+                current.compare(0, sizeof(USER_SET_STAMP_PREFIX) - 1, USER_SET_STAMP_PREFIX) == 0;
+            cout << "User set " << (otherSettings ? "provisioned for other settings" : "not provisioned")
+                 << ", configuring node by node (camrunner provision with the same options saves it)..." << endl;
+            return 1;
+        }
+
+        if (SelectUserSet(nodeMap, "UserSet1") < 0)
+        {
+            return -1;
+        }
+        CCommandPtr ptrUserSetLoad = nodeMap.GetNode("UserSetLoad");
+        if (!IsWritable(ptrUserSetLoad))
+        {
+            cout << "Unable to load User Set 1 (node retrieval)..." << endl;
+            return -1;
+        }
+        ptrUserSetLoad->Execute();
+        cout << "Loaded User Set 1 (" << stamp << ")..." << endl;
+    }
+    catch (Spinnaker::Exception& e)
+    {
+        cout << "Error loading user set 1: " << e.what() << endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Spinnaker\include\Spinnaker.h"
+#include "Spinnaker\include\SpinGenApi\SpinnakerGenApi.h"
+#include "captureConfig.h"
+#include <stdint.h>
+#include <string>
+
+// Bump whenever ConfigureCamera changes what it writes, so cameras provisioned
+// with the old settings are no longer trusted
+#define USER_SET_LAYOUT 1
+
+// Startup settings (ConfigureCamera, ConfigureRegion, continuous acquisition)
+// are saved once into UserSet1 by "camrunner provision", like the
+// AcquisitionMultipleCameraRecovery sample's ConfigureUserSet1. The camera's
+// DeviceUserID is stamped with a hash of those settings; a normal run whose
+// settings hash the same loads the set with one command instead of writing
+// each node. Per-run settings (trigger, frame rate, compression, chunk data)
+// are still written by AcquireImages.
+
+// Hash of the settings the user set holds for this config
+uint32_t UserSetHash(const CaptureConfig& config);
+
+// DeviceUserID value marking a camera provisioned for config
+std::string UserSetStamp(const CaptureConfig& config);
+
+// Loads the factory Default set, clearing whatever earlier runs left on the
+// camera (trigger, frame-rate lock, chunk data, compressed pixel format) so
+// it is not saved into UserSet1. Returns 0 or -1.
+int LoadDefaultUserSet(Spinnaker::GenApi::INodeMap& nodeMap);
+
+// Saves the current device settings to UserSet1, makes it the power-on
+// default and stamps DeviceUserID. Call after ConfigureCamera/ConfigureRegion.
+int SaveUserSet(Spinnaker::GenApi::INodeMap& nodeMap, const CaptureConfig& config);
+
+// Loads UserSet1 if DeviceUserID says it was provisioned for config. Returns 0
+// once loaded, 1 if the camera is not provisioned for these settings and -1 if
+// loading failed; either way the caller configures node by node instead.
+int LoadUserSet(Spinnaker::GenApi::INodeMap& nodeMap, const CaptureConfig& config);
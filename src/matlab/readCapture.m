@@ -0,0 +1,33 @@
+function [index,readFrame] = readCapture(basePath)
+    %Opens a camrunner capture container (basePath.ssi / basePath.ssd)
+    %index - struct array of frame records, memory mapped so opening is
+    %        constant time regardless of run length
+    %readFrame - readFrame(k) returns the k'th indexed frame as a matrix
+    headerBytes = 24;
+    entryFormat = {'int64',[1 1],'frameId'; ...
+                   'int64',[1 1],'deviceTimestamp'; ...
+                   'int64',[1 1],'hostMonotonicNs'; ...
+                   'uint64',[1 1],'offset'; ...
+                   'uint64',[1 1],'length'; ...
+                   'uint32',[1 1],'pixelFormat'; ...
+                   'uint32',[1 1],'width'; ...
+                   'uint32',[1 1],'height'; ...
+                   'uint32',[1 1],'payloadType'};
+    magic = memmapfile(append(basePath,'.ssi'),'Format','uint8','Repeat',7);
+    if ~strcmp(char(magic.Data'),'SSIDX01')
+        error('%s.ssi is not a capture index',basePath);
+    end
+    index = memmapfile(append(basePath,'.ssi'),'Offset',headerBytes,'Format',entryFormat);
+    data = memmapfile(append(basePath,'.ssd'),'Format','uint8');
+    readFrame = @(k) getFrame(index.Data(k),data);
+end
+
+function img = getFrame(entry,data)
+    if entry.payloadType ~= 0
+        error('Frame %d is stored compressed, decode it with Spinnaker first',entry.frameId);
+    end
+    %Frames are stored row major, MATLAB is column major
+    first = double(entry.offset) + 1;
+    raw = data.Data(first:first + double(entry.length) - 1);
+    img = reshape(raw,double(entry.width),double(entry.height))';
+end
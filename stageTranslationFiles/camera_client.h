@@ -0,0 +1,91 @@
+#ifndef CAMERA_CLIENT_H_
+#define CAMERA_CLIENT_H_
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// command socket of "camrunner daemon", see src/camera/captureDaemon.h
+#define CAMERA_SOCKET_PATH "/tmp/camrunner.sock"
+// start replies once the camera streams; stop waits for the last frames to save
+#define CAMERA_REPLY_TIMEOUT_S 30
+
+// results of camera_command; only CAMERA_NOT_RUNNING means nobody else holds the camera
+#define CAMERA_OK 0
+#define CAMERA_NOT_RUNNING -1	// no daemon listening on the socket
+#define CAMERA_REFUSED -2	// the daemon answered with an error or not at all
+
+// function protoypes
+int camera_command(const char*, char*, size_t);
+int camera_start(int, const char*);
+int camera_stop();
+
+// send one command line to the camera daemon and read its reply line.
+// returns CAMERA_OK on an "ok" reply, CAMERA_NOT_RUNNING if it could not
+// connect and CAMERA_REFUSED otherwise
+int camera_command(const char* command, char* reply, size_t reply_size){
+	reply[0] = '\0';
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0){
+		return CAMERA_NOT_RUNNING;
+	}
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, CAMERA_SOCKET_PATH, sizeof(address.sun_path) - 1);
+	if(connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+		close(fd);
+		return CAMERA_NOT_RUNNING;
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = CAMERA_REPLY_TIMEOUT_S;
+	timeout.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	char line[336];
+	int length = snprintf(line, sizeof(line), "%s\n", command);
+	if(write(fd, line, length) != length){
+		close(fd);
+		return CAMERA_REFUSED;
+	}
+
+	// read up to the end of the reply line
+	size_t used = 0;
+	while(used + 1 < reply_size){
+		ssize_t received = read(fd, reply + used, 1);
+		if(received <= 0 || reply[used] == '\n'){
+			break;
+		}
+		used++;
+	}
+	reply[used] = '\0';
+	close(fd);
+	return strncmp(reply, "ok", 2) == 0 ? CAMERA_OK : CAMERA_REFUSED;
+}
+
+// start a capture for the given slide size into directory name. returns once
+// the camera is streaming, so the caller can start moving straight away.
+// returns a camera_command result
+int camera_start(int size, const char* name){
+	char command[320];
+	char reply[128];
+	snprintf(command, sizeof(command), "start %i %s", size, name);
+	int result = camera_command(command, reply, sizeof(reply));
+	if(result == CAMERA_REFUSED){
+		printf("camera daemon: %s\n", reply[0] != '\0' ? reply : "no reply");
+	}
+	return result;
+}
+
+// end the running capture, if any
+int camera_stop(){
+	char reply[128];
+	return camera_command("stop", reply, sizeof(reply));
+}
+
+#endif /* CAMERA_CLIENT_H_ */
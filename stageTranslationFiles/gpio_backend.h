@@ -0,0 +1,324 @@
+#ifndef GPIO_BACKEND_H_
+#define GPIO_BACKEND_H_
+
+// Fast output paths for the stage pins. The exploringBB GPIO class writes
+// /sys/class/gpio/gpioN/value on every call, tens of microseconds a toggle.
+// FastGPIO keeps the sysfs export and direction setup from the base class and
+// sends writes through one of:
+//   sysfs - the base class, unchanged
+//   mmap  - AM335x GPIO bank registers mapped from /dev/mem (root); a write is
+//           one store to SETDATAOUT/CLEARDATAOUT, well under a microsecond
+//   gpiod - libgpiod character device (build with -DGPIO_GPIOD, link -lgpiod);
+//           the pins of each bank are requested as one bulk line set, so
+//           several pins change in one ioctl
+// Pins are attached after their direction is set. Under -DSIM_GPIO every
+// backend falls back to the simulated bank, which is already a memory write.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef GPIO_GPIOD
+#include <gpiod.h>
+#endif
+#include "common.h"
+
+using namespace exploringBB;
+
+typedef enum{
+	GPIO_BACKEND_SYSFS = 0,
+	GPIO_BACKEND_MMAP = 1,
+	GPIO_BACKEND_GPIOD = 2
+}GPIO_BACKEND_TYPE;
+
+// BeagleBone GPIO numbers are bank * 32 + bit; one gpiochip per bank
+#define GPIO_BANK_COUNT 4
+#define GPIO_BANK_PINS 32
+
+// AM335x GPIO module, TRM chapter 25
+#define AM335X_GPIO_BANK_SIZE 0x1000
+#define AM335X_GPIO_DATAIN 0x138
+#define AM335X_GPIO_CLEARDATAOUT 0x190
+#define AM335X_GPIO_SETDATAOUT 0x194
+static const off_t am335x_gpio_bank_base[GPIO_BANK_COUNT] = {0x44E07000, 0x4804C000, 0x481AC000, 0x481AE000};
+
+typedef struct{
+	GPIO_BACKEND_TYPE type;
+	bool attached[NUM_BBB_PINS];
+	volatile uint32_t* banks[GPIO_BANK_COUNT];	// mmap: mapped register blocks
+#ifdef GPIO_GPIOD
+	struct gpiod_chip* chips[GPIO_BANK_COUNT];
+	struct gpiod_line_bulk bulk[GPIO_BANK_COUNT];	// attached lines per bank
+	int bulk_index[NUM_BBB_PINS];			// position of a pin in its bank's bulk
+	int values[GPIO_BANK_COUNT][GPIO_BANK_PINS];	// last written level of every bulk line
+#endif
+}GPIO_BACKEND;
+
+// one backend per process, like the pins themselves
+static GPIO_BACKEND gpio_backend;
+
+// function protoypes
+int gpio_backend_parse(const char*, GPIO_BACKEND_TYPE*);
+const char* gpio_backend_name(GPIO_BACKEND_TYPE);
+int gpio_backend_open(GPIO_BACKEND_TYPE);
+int gpio_backend_attach(GPIO**, int);
+int gpio_backend_write(int, GPIO::VALUE);
+int gpio_backend_write_many(GPIO**, int, GPIO::VALUE);
+int gpio_backend_read(int);
+void gpio_backend_close();
+
+// drop-in for the exploringBB GPIO on output pins; until it is attached to
+// the backend it behaves exactly like the base class
+class FastGPIO : public GPIO {
+public:
+	FastGPIO(int number) : GPIO(number) {}
+
+	virtual int setValue(GPIO::VALUE value){
+		if(!gpio_backend.attached[getNumber()]){
+			return GPIO::setValue(value);
+		}
+		return gpio_backend_write(getNumber(), value);
+	}
+
+	virtual GPIO::VALUE getValue(){
+		if(!gpio_backend.attached[getNumber()]){
+			return GPIO::getValue();
+		}
+		return gpio_backend_read(getNumber()) ? GPIO::HIGH : GPIO::LOW;
+	}
+};
+
+// "sysfs", "mmap" or "gpiod"; returns -1 for anything else
+int gpio_backend_parse(const char* name, GPIO_BACKEND_TYPE* type){
+	if(!strcmp(name, "sysfs")){
+		*type = GPIO_BACKEND_SYSFS;
+	}
+	else if(!strcmp(name, "mmap")){
+		*type = GPIO_BACKEND_MMAP;
+	}
+	else if(!strcmp(name, "gpiod")){
+		*type = GPIO_BACKEND_GPIOD;
+	}
+	else{
+		return -1;
+	}
+	return 0;
+}
+
+const char* gpio_backend_name(GPIO_BACKEND_TYPE type){
+	switch(type){
+		case GPIO_BACKEND_MMAP: return "mmap";
+		case GPIO_BACKEND_GPIOD: return "gpiod";
+		default: return "sysfs";
+	}
+}
+
+// select the backend and open its device. On failure the backend stays on
+// sysfs and -1 is returned, so the stage still runs, just slower
+int gpio_backend_open(GPIO_BACKEND_TYPE type){
+	memset(&gpio_backend, 0, sizeof(gpio_backend));
+	gpio_backend.type = GPIO_BACKEND_SYSFS;
+#ifdef SIM_GPIO
+	if(type != GPIO_BACKEND_SYSFS){
+		printf("gpio: simulated pins, %s backend not used\n", gpio_backend_name(type));
+	}
+	return 0;
+#else
+	if(type == GPIO_BACKEND_MMAP){
+		int fd = open("/dev/mem", O_RDWR | O_SYNC);
+		if(fd < 0){
+			perror("gpio: /dev/mem");
+			return -1;
+		}
+		for(int i = 0; i < GPIO_BANK_COUNT; i++){
+			void* map = mmap(NULL, AM335X_GPIO_BANK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, am335x_gpio_bank_base[i]);
+			if(map == MAP_FAILED){
+				perror("gpio: mmap");
+				close(fd);
+				gpio_backend_close();
+				return -1;
+			}
+			gpio_backend.banks[i] = (volatile uint32_t*)map;
+		}
+		close(fd);
+	}
+	else if(type == GPIO_BACKEND_GPIOD){
+#ifdef GPIO_GPIOD
+		for(int i = 0; i < GPIO_BANK_COUNT; i++){
+			gpio_backend.chips[i] = gpiod_chip_open_by_number(i);
+			if(gpio_backend.chips[i] == NULL){
+				perror("gpio: gpiochip");
+				gpio_backend_close();
+				return -1;
+			}
+			gpiod_line_bulk_init(&gpio_backend.bulk[i]);
+		}
+#else
+		printf("gpio: built without libgpiod (-DGPIO_GPIOD -lgpiod), using sysfs\n");
+		return -1;
+#endif
+	}
+	gpio_backend.type = type;
+	return 0;
+#endif
+}
+
+#ifdef GPIO_GPIOD
+// undo a failed gpiod attach: drop the line requests and give the pins back
+// to sysfs as outputs, so the caller's fall back to sysfs can still drive them
+static void gpio_backend_gpiod_restore(GPIO** pins, int count){
+	for(int bank = 0; bank < GPIO_BANK_COUNT; bank++){
+		if(gpiod_line_bulk_num_lines(&gpio_backend.bulk[bank]) > 0){
+			gpiod_line_release_bulk(&gpio_backend.bulk[bank]);
+		}
+		gpiod_line_bulk_init(&gpio_backend.bulk[bank]);
+	}
+	for(int i = 0; i < count; i++){
+		FILE* reexport = fopen("/sys/class/gpio/export", "w");
+		if(reexport != NULL){
+			fprintf(reexport, "%d", pins[i]->getNumber());
+			fclose(reexport);
+		}
+	}
+	// udev needs a moment to set the permissions, as the exploringBB GPIO constructor allows
+	usleep(250000);
+	for(int i = 0; i < count; i++){
+		pins[i]->setDirection(GPIO::OUTPUT);
+	}
+}
+#endif
+
+// hand count output pins, direction already set through sysfs, to the backend
+int gpio_backend_attach(GPIO** pins, int count){
+	if(gpio_backend.type == GPIO_BACKEND_SYSFS){
+		return 0;
+	}
+#ifdef GPIO_GPIOD
+	if(gpio_backend.type == GPIO_BACKEND_GPIOD){
+		for(int i = 0; i < count; i++){
+			int number = pins[i]->getNumber();
+			int bank = number / GPIO_BANK_PINS;
+			// a line exported through sysfs is busy for the character device
+			FILE* unexport = fopen("/sys/class/gpio/unexport", "w");
+			if(unexport != NULL){
+				fprintf(unexport, "%d", number);
+				fclose(unexport);
+			}
+			struct gpiod_line* line = gpiod_chip_get_line(gpio_backend.chips[bank], number % GPIO_BANK_PINS);
+			if(line == NULL){
+				perror("gpio: gpiod line");
+				gpio_backend_gpiod_restore(pins, count);
+				return -1;
+			}
+			gpio_backend.bulk_index[number] = gpiod_line_bulk_num_lines(&gpio_backend.bulk[bank]);
+			gpio_backend.values[bank][gpio_backend.bulk_index[number]] = 0;
+			gpiod_line_bulk_add(&gpio_backend.bulk[bank], line);
+		}
+		for(int bank = 0; bank < GPIO_BANK_COUNT; bank++){
+			if(gpiod_line_bulk_num_lines(&gpio_backend.bulk[bank]) == 0){
+				continue;
+			}
+			if(gpiod_line_request_bulk_output(&gpio_backend.bulk[bank], "translate", gpio_backend.values[bank]) != 0){
+				perror("gpio: gpiod request");
+				gpio_backend_gpiod_restore(pins, count);
+				return -1;
+			}
+		}
+	}
+#endif
+	for(int i = 0; i < count; i++){
+		gpio_backend.attached[pins[i]->getNumber()] = true;
+	}
+	return 0;
+}
+
+int gpio_backend_write(int number, GPIO::VALUE value){
+	int bank = number / GPIO_BANK_PINS;
+	if(gpio_backend.type == GPIO_BACKEND_MMAP){
+		gpio_backend.banks[bank][(value == GPIO::HIGH ? AM335X_GPIO_SETDATAOUT : AM335X_GPIO_CLEARDATAOUT) / 4] =
+			1u << (number % GPIO_BANK_PINS);
+		return 0;
+	}
+#ifdef GPIO_GPIOD
+	if(gpio_backend.type == GPIO_BACKEND_GPIOD){
+		// the request covers the whole bank's bulk, so every line is rewritten
+		gpio_backend.values[bank][gpio_backend.bulk_index[number]] = value;
+		return gpiod_line_set_value_bulk(&gpio_backend.bulk[bank], gpio_backend.values[bank]);
+	}
+#endif
+	return -1;
+}
+
+// drive several pins to one level with as few writes as possible: one store
+// (mmap) or one ioctl (gpiod) per bank, e.g. both step lines at once
+int gpio_backend_write_many(GPIO** pins, int count, GPIO::VALUE value){
+	if(gpio_backend.type == GPIO_BACKEND_SYSFS){
+		int result = 0;
+		for(int i = 0; i < count; i++){
+			result |= pins[i]->setValue(value);
+		}
+		return result;
+	}
+	uint32_t masks[GPIO_BANK_COUNT] = {0};
+	for(int i = 0; i < count; i++){
+		int number = pins[i]->getNumber();
+		masks[number / GPIO_BANK_PINS] |= 1u << (number % GPIO_BANK_PINS);
+#ifdef GPIO_GPIOD
+		if(gpio_backend.type == GPIO_BACKEND_GPIOD){
+			gpio_backend.values[number / GPIO_BANK_PINS][gpio_backend.bulk_index[number]] = value;
+		}
+#endif
+	}
+	int result = 0;
+	for(int bank = 0; bank < GPIO_BANK_COUNT; bank++){
+		if(masks[bank] == 0){
+			continue;
+		}
+		if(gpio_backend.type == GPIO_BACKEND_MMAP){
+			gpio_backend.banks[bank][(value == GPIO::HIGH ? AM335X_GPIO_SETDATAOUT : AM335X_GPIO_CLEARDATAOUT) / 4] =
+				masks[bank];
+		}
+#ifdef GPIO_GPIOD
+		else if(gpio_backend.type == GPIO_BACKEND_GPIOD){
+			result |= gpiod_line_set_value_bulk(&gpio_backend.bulk[bank], gpio_backend.values[bank]);
+		}
+#endif
+	}
+	return result;
+}
+
+int gpio_backend_read(int number){
+	int bank = number / GPIO_BANK_PINS;
+	if(gpio_backend.type == GPIO_BACKEND_MMAP){
+		return (gpio_backend.banks[bank][AM335X_GPIO_DATAIN / 4] >> (number % GPIO_BANK_PINS)) & 1;
+	}
+#ifdef GPIO_GPIOD
+	if(gpio_backend.type == GPIO_BACKEND_GPIOD){
+		// outputs read back what was last written
+		return gpio_backend.values[bank][gpio_backend.bulk_index[number]];
+	}
+#endif
+	return 0;
+}
+
+void gpio_backend_close(){
+	for(int i = 0; i < GPIO_BANK_COUNT; i++){
+		if(gpio_backend.banks[i] != NULL){
+			munmap((void*)gpio_backend.banks[i], AM335X_GPIO_BANK_SIZE);
+			gpio_backend.banks[i] = NULL;
+		}
+#ifdef GPIO_GPIOD
+		if(gpio_backend.chips[i] != NULL){
+			gpiod_chip_close(gpio_backend.chips[i]);
+			gpio_backend.chips[i] = NULL;
+		}
+#endif
+	}
+	memset(gpio_backend.attached, 0, sizeof(gpio_backend.attached));
+	gpio_backend.type = GPIO_BACKEND_SYSFS;
+}
+
+#endif /* GPIO_BACKEND_H_ */
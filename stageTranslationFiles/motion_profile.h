@@ -0,0 +1,219 @@
+#ifndef MOTION_PROFILE_H_
+#define MOTION_PROFILE_H_
+
+// Step timestamps for a move of N steps under velocity, acceleration and jerk
+// limits, in steps/s, steps/s^2 and steps/s^3:
+//   constant  - every step at max_velocity, as the old usleep loops did
+//   trapezoid - constant acceleration up to max_velocity, cruise, mirror down
+//   scurve    - the same with acceleration ramped at the jerk limit, so the
+//               motors see no step change in torque (7-segment profile)
+// Moves too short to reach max_velocity peak lower. Step k fires when the
+// planned position passes k + 0.5, which keeps the decelerating half an
+// exact mirror of the accelerating half.
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "step_generator.h"
+
+typedef enum{
+	PROFILE_CONSTANT = 0,
+	PROFILE_TRAPEZOID = 1,
+	PROFILE_SCURVE = 2
+}PROFILE_TYPE;
+
+typedef struct{
+	PROFILE_TYPE type;
+	double max_velocity;		// steps/s
+	double max_acceleration;	// steps/s^2
+	double jerk;			// steps/s^3, scurve only
+}MOTION_LIMITS;
+
+// one planned move: an accelerating half described by its segment times,
+// a cruise and the mirrored deceleration
+typedef struct{
+	double distance;	// steps
+	double peak_velocity;
+	double jerk_time;	// each jerk segment of the ramp, 0 for trapezoid
+	double accel_time;	// constant-acceleration segment of the ramp
+	double peak_accel;
+	double jerk;
+	double ramp_time;	// whole acceleration ramp
+	double ramp_distance;
+	double total_time;
+}MOTION_PLAN;
+
+// function protoypes
+int motion_profile_parse(const char*, PROFILE_TYPE*);
+const char* motion_profile_name(PROFILE_TYPE);
+void motion_plan(const MOTION_LIMITS*, double, MOTION_PLAN*);
+double motion_plan_time_at(const MOTION_PLAN*, double);
+void step_move_profile(STEP_MOVE*, const MOTION_LIMITS*, uint32_t, uint8_t);
+void step_move_line(STEP_MOVE*, const MOTION_LIMITS*, uint32_t, uint32_t);
+
+int motion_profile_parse(const char* name, PROFILE_TYPE* type){
+	if(!strcmp(name, "constant")){
+		*type = PROFILE_CONSTANT;
+	}
+	else if(!strcmp(name, "trapezoid")){
+		*type = PROFILE_TRAPEZOID;
+	}
+	else if(!strcmp(name, "scurve")){
+		*type = PROFILE_SCURVE;
+	}
+	else{
+		return -1;
+	}
+	return 0;
+}
+
+const char* motion_profile_name(PROFILE_TYPE type){
+	switch(type){
+		case PROFILE_TRAPEZOID: return "trapezoid";
+		case PROFILE_SCURVE: return "scurve";
+		default: return "constant";
+	}
+}
+
+// segment times of a ramp from rest to velocity under the plan's limits
+static void motion_ramp(MOTION_PLAN* plan, PROFILE_TYPE type, double accel, double velocity){
+	plan->peak_velocity = velocity;
+	if(type == PROFILE_SCURVE && velocity * plan->jerk < accel * accel){
+		// jerk-limited all the way, acceleration peaks below the limit
+		plan->jerk_time = sqrt(velocity / plan->jerk);
+		plan->accel_time = 0.0;
+		plan->peak_accel = plan->jerk * plan->jerk_time;
+	}
+	else if(type == PROFILE_SCURVE){
+		plan->jerk_time = accel / plan->jerk;
+		plan->accel_time = velocity / accel - plan->jerk_time;
+		plan->peak_accel = accel;
+	}
+	else{
+		plan->jerk_time = 0.0;
+		plan->accel_time = velocity / accel;
+		plan->peak_accel = accel;
+	}
+	plan->ramp_time = 2.0 * plan->jerk_time + plan->accel_time;
+	// the ramp is point-symmetric about its midpoint, so it averages half the velocity
+	plan->ramp_distance = velocity * plan->ramp_time / 2.0;
+}
+
+void motion_plan(const MOTION_LIMITS* limits, double distance, MOTION_PLAN* plan){
+	memset(plan, 0, sizeof(*plan));
+	plan->distance = distance;
+	plan->jerk = limits->jerk;
+	if(limits->type == PROFILE_CONSTANT || limits->max_acceleration <= 0 ||
+	   (limits->type == PROFILE_SCURVE && limits->jerk <= 0)){
+		plan->peak_velocity = limits->max_velocity;
+		plan->total_time = distance / limits->max_velocity;
+		return;
+	}
+
+	motion_ramp(plan, limits->type, limits->max_acceleration, limits->max_velocity);
+	if(2.0 * plan->ramp_distance > distance){
+		// too short to reach full speed: find the peak whose two ramps fill the move
+		double low = 0.0;
+		double high = limits->max_velocity;
+		for(int i = 0; i < 60; i++){
+			double middle = 0.5 * (low + high);
+			motion_ramp(plan, limits->type, limits->max_acceleration, middle);
+			if(2.0 * plan->ramp_distance > distance){
+				high = middle;
+			}
+			else{
+				low = middle;
+			}
+		}
+		motion_ramp(plan, limits->type, limits->max_acceleration, low);
+	}
+	plan->total_time = 2.0 * plan->ramp_time + (distance - 2.0 * plan->ramp_distance) / plan->peak_velocity;
+}
+
+// distance covered t seconds into the acceleration ramp
+static double motion_ramp_position(const MOTION_PLAN* plan, double t){
+	double j = plan->jerk;
+	double t1 = plan->jerk_time;
+	double a = plan->peak_accel;
+	if(t1 == 0.0){
+		return 0.5 * a * t * t;
+	}
+	if(t <= t1){
+		return j * t * t * t / 6.0;
+	}
+	double v1 = 0.5 * j * t1 * t1;
+	double s1 = j * t1 * t1 * t1 / 6.0;
+	double tau = t - t1;
+	if(tau <= plan->accel_time){
+		return s1 + v1 * tau + 0.5 * a * tau * tau;
+	}
+	double t2 = plan->accel_time;
+	double v2 = v1 + a * t2;
+	double s2 = s1 + v1 * t2 + 0.5 * a * t2 * t2;
+	tau -= t2;
+	return s2 + v2 * tau + 0.5 * a * tau * tau - j * tau * tau * tau / 6.0;
+}
+
+// time into the ramp at which it has covered distance, by bisection
+static double motion_ramp_time_at(const MOTION_PLAN* plan, double distance){
+	double low = 0.0;
+	double high = plan->ramp_time;
+	for(int i = 0; i < 48; i++){
+		double middle = 0.5 * (low + high);
+		if(motion_ramp_position(plan, middle) < distance){
+			low = middle;
+		}
+		else{
+			high = middle;
+		}
+	}
+	return 0.5 * (low + high);
+}
+
+// seconds from the start of the move until it reaches position
+double motion_plan_time_at(const MOTION_PLAN* plan, double position){
+	if(plan->ramp_time == 0.0){
+		return position / plan->peak_velocity;
+	}
+	if(position <= plan->ramp_distance){
+		return motion_ramp_time_at(plan, position);
+	}
+	if(position >= plan->distance - plan->ramp_distance){
+		return plan->total_time - motion_ramp_time_at(plan, plan->distance - position);
+	}
+	return plan->ramp_time + (position - plan->ramp_distance) / plan->peak_velocity;
+}
+
+// fill move with steps of a profiled move, all raising pins
+void step_move_profile(STEP_MOVE* move, const MOTION_LIMITS* limits, uint32_t steps, uint8_t pins){
+	MOTION_PLAN plan;
+	motion_plan(limits, steps, &plan);
+	step_move_clear(move);
+	move->events.reserve(steps);
+	for(uint32_t i = 0; i < steps; i++){
+		step_move_add(move, (uint64_t)(motion_plan_time_at(&plan, i + 0.5) * 1e9), pins);
+	}
+}
+
+// coordinated move of x_steps and y_steps along a straight line. The longer
+// axis follows the profile; the shorter one steps on the same edges whenever
+// the Bresenham error term carries, so both axes arrive on the last step and
+// the move takes max(x, y) steps instead of x + y one axis after the other
+void step_move_line(STEP_MOVE* move, const MOTION_LIMITS* limits, uint32_t x_steps, uint32_t y_steps){
+	bool x_major = x_steps >= y_steps;
+	uint32_t major = x_major ? x_steps : y_steps;
+	uint32_t minor = x_major ? y_steps : x_steps;
+	step_move_profile(move, limits, major, x_major ? STEP_PIN_X : STEP_PIN_Y);
+
+	// starting half way spreads the minor steps evenly, exactly minor of them
+	uint64_t error = major / 2;
+	for(uint32_t i = 0; i < major; i++){
+		error += minor;
+		if(error >= major){
+			error -= major;
+			move->events[i].pins |= x_major ? STEP_PIN_Y : STEP_PIN_X;
+		}
+	}
+}
+
+#endif /* MOTION_PROFILE_H_ */
@@ -0,0 +1,84 @@
+#ifndef SIMGPIO_H_
+#define SIMGPIO_H_
+
+// Stand-in for the Exploring BeagleBone GPIO class so translate.cpp can run
+// on any Linux machine: build with -DSIM_GPIO. Pin levels and rising edge
+// counts live in a small shared file instead of sysfs, so a simulated camera
+// (camrunner --source=replay --trigger=Line0) can watch the trigger pin.
+// The layout is mirrored by src/camera/simTrigger.h.
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "common.h"
+
+#define SIM_GPIO_BANK_PATH "/tmp/superstitch_sim_gpio"
+
+typedef struct{
+	uint32_t value[NUM_BBB_PINS];
+	uint32_t rising_edges[NUM_BBB_PINS];
+}SIM_GPIO_BANK;
+
+// map the shared bank once per process, creating it if we are first
+static SIM_GPIO_BANK* sim_gpio_bank(){
+	static SIM_GPIO_BANK* bank = NULL;
+	if(bank == NULL){
+		int fd = open(SIM_GPIO_BANK_PATH, O_RDWR | O_CREAT, 0666);
+		if(fd < 0 || ftruncate(fd, sizeof(SIM_GPIO_BANK)) != 0){
+			perror("sim gpio: " SIM_GPIO_BANK_PATH);
+			exit(1);
+		}
+		void* map = mmap(NULL, sizeof(SIM_GPIO_BANK), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		if(map == MAP_FAILED){
+			perror("sim gpio: mmap");
+			exit(1);
+		}
+		bank = (SIM_GPIO_BANK*)map;
+	}
+	return bank;
+}
+
+namespace exploringBB {
+
+// the subset of the GPIO interface translate.cpp and utilities.h use
+class GPIO {
+public:
+	enum DIRECTION{ INPUT, OUTPUT };
+	enum VALUE{ LOW=0, HIGH=1 };
+
+	GPIO(int number) : number(number), direction(INPUT) {}
+
+	virtual int getNumber() { return number; }
+
+	virtual int setDirection(GPIO::DIRECTION dir){
+		direction = dir;
+		return 0;
+	}
+
+	virtual int setValue(GPIO::VALUE value){
+		SIM_GPIO_BANK* bank = sim_gpio_bank();
+		if(value == HIGH && bank->value[number] == LOW){
+			__atomic_fetch_add(&bank->rising_edges[number], 1, __ATOMIC_RELEASE);
+		}
+		bank->value[number] = value;
+		return 0;
+	}
+
+	virtual GPIO::VALUE getValue(){
+		return (GPIO::VALUE)sim_gpio_bank()->value[number];
+	}
+
+	virtual ~GPIO() {}
+
+private:
+	int number;
+	GPIO::DIRECTION direction;
+};
+
+} /* namespace exploringBB */
+
+#endif /* SIMGPIO_H_ */
@@ -0,0 +1,344 @@
+#ifndef STAGE_COMMAND_H_
+#define STAGE_COMMAND_H_
+
+// Event-driven command channel for the stage state machine. Commands arrive
+// as typed binary messages on a Unix SOCK_SEQPACKET socket (one message per
+// packet, see stagectl.cpp), and the old files are still honoured through
+// inotify: closing command_file.txt, size_file.txt or file_name.txt after
+// writing it applies it at once, without the polling loop's sleeps. Write the
+// size and file name before the command, as before.
+//
+// The state machine blocks in stage_channel_wait while READY or IDLE and
+// polls without waiting between moves; either way a command is seen as soon
+// as it arrives rather than on the next file read.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+
+// use the standard namespace
+using namespace std;
+
+#define STAGE_SOCKET_PATH "/tmp/superstitch_stage.sock"
+#define STAGE_MESSAGE_MAGIC 0x31475453	// "STG1"
+// the name becomes a directory holding <name>/<prefix>-<time>.jpg; 128 leaves
+// the prefix, camera serial and timestamp room within a 255 byte file path
+#define STAGE_NAME_MAX 128
+#define STAGE_MAX_CLIENTS 4
+// commands are applied between moves, so a reply can take up to one row
+#define STAGE_REPLY_TIMEOUT_S 60
+// longest wait for the command of a client that has just connected
+#define STAGE_FIRST_PACKET_MS 50
+
+// the command codes are the ones command_file.txt has always held
+typedef enum{
+	STAGE_CMD_START = 0,	// payload: capture file name, not terminated
+	STAGE_CMD_STOP = 1,
+	STAGE_CMD_REWIND = 2,
+	STAGE_CMD_SET_SIZE = 3	// payload: int32_t slide size
+}STAGE_COMMAND_TYPE;
+
+// every message is this header and length payload bytes in one packet; the
+// reply is an int32_t, 0 if the command was applied and -1 if it was not
+typedef struct{
+	uint32_t magic;
+	uint16_t type;
+	uint16_t length;
+}STAGE_MESSAGE_HEADER;
+
+typedef struct{
+	int listen_fd;
+	int client_fds[STAGE_MAX_CLIENTS];
+	int inotify_fd;
+	int command;		// last command, -1 for none, same meaning as command_file.txt
+	int size;		// slide size, -1 until set
+	string file_name;
+}STAGE_CHANNEL;
+
+// function protoypes
+int stage_channel_open(STAGE_CHANNEL*, const char*);
+int stage_channel_wait(STAGE_CHANNEL*, int);
+int stage_command_send(const char*, STAGE_COMMAND_TYPE, const void*, uint16_t);
+
+// capture names end up in a shell command (run_camera.sh), so only letters,
+// digits, '.', '_' and '-', and at most STAGE_NAME_MAX of them. They are also
+// created as directories, so "." and ".." (or any all-dot name) are refused.
+static bool stage_name_valid(const char* name, size_t length){
+	if(length == 0 || length > STAGE_NAME_MAX){
+		return false;
+	}
+	bool only_dots = true;
+	for(size_t i = 0; i < length; i++){
+		char c = name[i];
+		if(!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '_' || c == '-')){
+			return false;
+		}
+		if(c != '.'){
+			only_dots = false;
+		}
+	}
+	return !only_dots;
+}
+
+// apply one command; returns 0 if it was understood
+static int stage_channel_apply(STAGE_CHANNEL* channel, int type, const char* payload, uint16_t length){
+	switch(type){
+		case STAGE_CMD_START:
+			if(length > 0){
+				if(!stage_name_valid(payload, length)){
+					return -1;
+				}
+				channel->file_name.assign(payload, length);
+			}
+			channel->command = STAGE_CMD_START;
+			return 0;
+		case STAGE_CMD_STOP:
+		case STAGE_CMD_REWIND:
+			channel->command = type;
+			return 0;
+		case STAGE_CMD_SET_SIZE:
+			if(length != sizeof(int32_t)){
+				return -1;
+			}
+			int32_t size;
+			memcpy(&size, payload, sizeof(size));
+			channel->size = size;
+			return 0;
+		default:
+			return -1;
+	}
+}
+
+// read the first whitespace separated value of a compatibility file
+template <typename T>
+static bool stage_read_file(const char* path, T* value){
+	ifstream file(path);
+	return (bool)(file >> *value);
+}
+
+static void stage_write_file(const char* path, int value){
+	ofstream file(path, ofstream::trunc);
+	file << value;
+}
+
+// open the socket and the file watch. Either may fail on its own and the
+// other still works; -1 only if neither does
+int stage_channel_open(STAGE_CHANNEL* channel, const char* socket_path){
+	channel->command = -1;
+	channel->size = -1;
+	channel->file_name.clear();
+	for(int i = 0; i < STAGE_MAX_CLIENTS; i++){
+		channel->client_fds[i] = -1;
+	}
+
+	// stale commands from the last run must not start a scan
+	stage_write_file("./command_file.txt", -1);
+	stage_write_file("./size_file.txt", -1);
+
+	channel->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(channel->inotify_fd >= 0 && inotify_add_watch(channel->inotify_fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0){
+		perror("stage command: inotify_add_watch");
+		close(channel->inotify_fd);
+		channel->inotify_fd = -1;
+	}
+
+	channel->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+	unlink(socket_path);
+	if(channel->listen_fd >= 0 &&
+	   (bind(channel->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(channel->listen_fd, STAGE_MAX_CLIENTS) != 0)){
+		perror("stage command: " STAGE_SOCKET_PATH);
+		close(channel->listen_fd);
+		channel->listen_fd = -1;
+	}
+
+	return (channel->listen_fd >= 0 || channel->inotify_fd >= 0) ? 0 : -1;
+}
+
+// one packet from a client: apply it and reply; drop the client on hang-up
+static int stage_channel_read_client(STAGE_CHANNEL* channel, int slot){
+	char packet[sizeof(STAGE_MESSAGE_HEADER) + STAGE_NAME_MAX];
+	ssize_t received = recv(channel->client_fds[slot], packet, sizeof(packet), 0);
+	if(received <= 0){
+		if(received == 0 || (errno != EAGAIN && errno != EINTR)){
+			close(channel->client_fds[slot]);
+			channel->client_fds[slot] = -1;
+		}
+		return 0;
+	}
+
+	int32_t reply = -1;
+	STAGE_MESSAGE_HEADER header;
+	if((size_t)received >= sizeof(header)){
+		memcpy(&header, packet, sizeof(header));
+		if(header.magic == STAGE_MESSAGE_MAGIC && header.length == received - sizeof(header)){
+			reply = stage_channel_apply(channel, header.type, packet + sizeof(header), header.length);
+		}
+	}
+	send(channel->client_fds[slot], &reply, sizeof(reply), MSG_NOSIGNAL);
+	return reply == 0 ? 1 : 0;
+}
+
+// a compatibility file was closed after writing: read it as the old loop did
+static int stage_channel_read_files(STAGE_CHANNEL* channel){
+	char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	int applied = 0;
+	ssize_t length;
+	while((length = read(channel->inotify_fd, events, sizeof(events))) > 0){
+		for(char* p = events; p < events + length; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len){
+			const struct inotify_event* event = (const struct inotify_event*)p;
+			if(event->len == 0){
+				continue;
+			}
+			int value;
+			string name;
+			if(!strcmp(event->name, "command_file.txt") && stage_read_file("./command_file.txt", &value) && value != -1){
+				if(value == STAGE_CMD_START && stage_read_file("./file_name.txt", &name)){
+					if(!stage_name_valid(name.c_str(), name.size())){
+						printf("stage command: bad capture name in file_name.txt, START ignored\n");
+						continue;
+					}
+					channel->file_name = name;
+				}
+				applied += stage_channel_apply(channel, value, NULL, 0) == 0;
+			}
+			else if(!strcmp(event->name, "size_file.txt") && stage_read_file("./size_file.txt", &value) && value != -1){
+				channel->size = value;
+				applied++;
+			}
+			else if(!strcmp(event->name, "file_name.txt") && stage_read_file("./file_name.txt", &name) &&
+				stage_name_valid(name.c_str(), name.size())){
+				channel->file_name = name;
+			}
+		}
+	}
+	return applied;
+}
+
+// wait up to timeout_ms (0 to just look) for commands and apply all that are
+// ready; returns how many were applied. Keeps looking until nothing is left,
+// so a command from a client that has only just connected is applied in this
+// call, not at the next one a whole move later
+int stage_channel_wait(STAGE_CHANNEL* channel, int timeout_ms){
+	int applied = 0;
+	while(1){
+		struct pollfd fds[STAGE_MAX_CLIENTS + 2];
+		int count = 0;
+		if(channel->listen_fd >= 0){
+			fds[count].fd = channel->listen_fd;
+			fds[count++].events = POLLIN;
+		}
+		if(channel->inotify_fd >= 0){
+			fds[count].fd = channel->inotify_fd;
+			fds[count++].events = POLLIN;
+		}
+		for(int i = 0; i < STAGE_MAX_CLIENTS; i++){
+			if(channel->client_fds[i] >= 0){
+				fds[count].fd = channel->client_fds[i];
+				fds[count++].events = POLLIN;
+			}
+		}
+		if(count == 0){
+			usleep(timeout_ms * 1000);
+			return 0;
+		}
+		if(poll(fds, count, timeout_ms) <= 0){
+			return applied;
+		}
+		timeout_ms = 0;
+
+		for(int i = 0; i < count; i++){
+			if(fds[i].revents == 0){
+				continue;
+			}
+			if(fds[i].fd == channel->listen_fd){
+				int client = accept4(channel->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+				int slot = 0;
+				while(slot < STAGE_MAX_CLIENTS && channel->client_fds[slot] >= 0){
+					slot++;
+				}
+				if(client >= 0 && slot < STAGE_MAX_CLIENTS){
+					channel->client_fds[slot] = client;
+					// clients send straight after connecting; give the packet
+					// a moment to land rather than leave it for the next call
+					struct pollfd first;
+					first.fd = client;
+					first.events = POLLIN;
+					if(poll(&first, 1, STAGE_FIRST_PACKET_MS) > 0){
+						applied += stage_channel_read_client(channel, slot);
+					}
+				}
+				else if(client >= 0){
+					close(client);
+				}
+			}
+			else if(fds[i].fd == channel->inotify_fd){
+				applied += stage_channel_read_files(channel);
+			}
+			else{
+				for(int slot = 0; slot < STAGE_MAX_CLIENTS; slot++){
+					if(channel->client_fds[slot] == fds[i].fd){
+						applied += stage_channel_read_client(channel, slot);
+					}
+				}
+			}
+		}
+	}
+}
+
+// client side: send one command and wait for its reply. Returns 0 if the
+// stage applied it, -1 if it refused or is not running
+int stage_command_send(const char* socket_path, STAGE_COMMAND_TYPE type, const void* payload, uint16_t length){
+	if(length > STAGE_NAME_MAX){
+		return -1;
+	}
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if(fd < 0){
+		return -1;
+	}
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+	if(connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0){
+		close(fd);
+		return -1;
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = STAGE_REPLY_TIMEOUT_S;
+	timeout.tv_usec = 0;
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	char packet[sizeof(STAGE_MESSAGE_HEADER) + STAGE_NAME_MAX];
+	STAGE_MESSAGE_HEADER header;
+	header.magic = STAGE_MESSAGE_MAGIC;
+	header.type = type;
+	header.length = length;
+	memcpy(packet, &header, sizeof(header));
+	if(length > 0){
+		memcpy(packet + sizeof(header), payload, length);
+	}
+	int32_t reply = -1;
+	if(send(fd, packet, sizeof(header) + length, MSG_NOSIGNAL) != (ssize_t)(sizeof(header) + length) ||
+	   recv(fd, &reply, sizeof(reply), 0) != sizeof(reply)){
+		reply = -1;
+	}
+	close(fd);
+	return reply == 0 ? 0 : -1;
+}
+
+#endif /* STAGE_COMMAND_H_ */
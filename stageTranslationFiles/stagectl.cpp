@@ -0,0 +1,52 @@
+// include iostream for console input/output
+#include <iostream>
+// include string to use c-style string functions for argument parsing
+#include <string.h>
+// include stdlib for atoi
+#include <stdlib.h>
+// include stage_command.h for the command message protocol
+#include "stage_command.h"
+
+// send one command to a running translate over its command socket
+//   "stagectl start <size> <file name>" - sets the slide size, then starts a scan
+//   "stagectl stop" | "stagectl rewind" | "stagectl size <size>"
+// exits 0 once translate has applied the command, 1 otherwise
+int main(int argc, char *argv[])
+{
+	int result = -1;
+
+	if(argc == 4 && !strcmp(argv[1], "start"))
+	{
+		int32_t size = atoi(argv[2]);
+		result = stage_command_send(STAGE_SOCKET_PATH, STAGE_CMD_SET_SIZE, &size, sizeof(size));
+		if(result == 0)
+		{
+			result = stage_command_send(STAGE_SOCKET_PATH, STAGE_CMD_START, argv[3], strlen(argv[3]));
+		}
+	}
+	else if(argc == 3 && !strcmp(argv[1], "size"))
+	{
+		int32_t size = atoi(argv[2]);
+		result = stage_command_send(STAGE_SOCKET_PATH, STAGE_CMD_SET_SIZE, &size, sizeof(size));
+	}
+	else if(argc == 2 && !strcmp(argv[1], "stop"))
+	{
+		result = stage_command_send(STAGE_SOCKET_PATH, STAGE_CMD_STOP, NULL, 0);
+	}
+	else if(argc == 2 && !strcmp(argv[1], "rewind"))
+	{
+		result = stage_command_send(STAGE_SOCKET_PATH, STAGE_CMD_REWIND, NULL, 0);
+	}
+	else
+	{
+		cout << "Usage: stagectl start <size> <file name> | stop | rewind | size <size>" << endl;
+		return 1;
+	}
+
+	if(result != 0)
+	{
+		cout << "Error: translate is not running or refused the command" << endl;
+		return 1;
+	}
+	return 0;
+}
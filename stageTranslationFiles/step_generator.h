@@ -0,0 +1,243 @@
+#ifndef STEP_GENERATOR_H_
+#define STEP_GENERATOR_H_
+
+// Step pulses from a precomputed schedule on a dedicated motion thread. Each
+// rising edge has an absolute deadline on CLOCK_MONOTONIC and the thread
+// sleeps to it with clock_nanosleep(TIMER_ABSTIME), so a late wake-up delays
+// one pulse instead of every pulse after it the way usleep loops drift.
+// With realtime on, the thread runs SCHED_FIFO and the process memory is
+// locked (mlockall), so page faults and normal tasks do not stall a move;
+// both need root or CAP_SYS_NICE/CAP_IPC_LOCK and fall back with a warning.
+//
+// The state machine builds a STEP_MOVE, hands it over with step_generator_run
+// and does its bookkeeping (positions, trigger log) once the move is done, so
+// the motion thread never touches files. How late each edge was is collected
+// per move.
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <vector>
+#include "gpio_backend.h"
+
+// use the standard namespace
+using namespace std;
+
+// pins raised together by one schedule entry
+#define STEP_PIN_X 0x1
+#define STEP_PIN_Y 0x2
+#define STEP_PIN_TRIGGER 0x4
+
+// high time of a step pulse; the drivers need a few microseconds, the camera
+// trigger input about the same. Halved for steps closer together than twice this.
+#define STEP_PULSE_NS 20000
+// first edge of a move this long after it is handed over
+#define STEP_START_LEAD_NS 1000000
+#define STEP_RT_PRIORITY 80
+
+typedef struct{
+	uint64_t time_ns;	// rising edge, from the start of the move
+	uint8_t pins;		// STEP_PIN_* raised at time_ns
+}STEP_EVENT;
+
+// lateness of the rising edges against their deadlines
+typedef struct{
+	uint32_t steps;
+	double sum_ns;
+	double sum_sq_ns;
+	int64_t max_ns;
+}STEP_JITTER;
+
+typedef struct{
+	vector<STEP_EVENT> events;
+	STEP_JITTER jitter;	// filled in by the motion thread
+}STEP_MOVE;
+
+typedef struct{
+	GPIO* pins[3];		// X step, Y step, trigger, in STEP_PIN_* bit order
+	bool realtime;		// SCHED_FIFO thread and locked memory
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	STEP_MOVE* pending;	// move handed to the thread, NULL once it is done
+}STEP_GENERATOR;
+
+// function protoypes
+void step_move_clear(STEP_MOVE*);
+void step_move_add(STEP_MOVE*, uint64_t, uint8_t);
+void step_move_constant(STEP_MOVE*, uint32_t, uint8_t, uint64_t);
+int step_generator_start(STEP_GENERATOR*, GPIO*, GPIO*, GPIO*, bool);
+void step_generator_run(STEP_GENERATOR*, STEP_MOVE*);
+void step_jitter_print(const char*, const STEP_JITTER*);
+
+void step_move_clear(STEP_MOVE* move){
+	move->events.clear();
+	memset(&move->jitter, 0, sizeof(move->jitter));
+}
+
+void step_move_add(STEP_MOVE* move, uint64_t time_ns, uint8_t pins){
+	STEP_EVENT event;
+	event.time_ns = time_ns;
+	event.pins = pins;
+	move->events.push_back(event);
+}
+
+// steps evenly spaced period_ns apart, first one at time 0
+void step_move_constant(STEP_MOVE* move, uint32_t steps, uint8_t pins, uint64_t period_ns){
+	step_move_clear(move);
+	move->events.reserve(steps);
+	for(uint32_t i = 0; i < steps; i++){
+		step_move_add(move, (uint64_t)i * period_ns, pins);
+	}
+}
+
+static void step_timespec_add(struct timespec* t, uint64_t ns){
+	uint64_t total = (uint64_t)t->tv_nsec + ns;
+	t->tv_sec += total / 1000000000ULL;
+	t->tv_nsec = total % 1000000000ULL;
+}
+
+static int64_t step_timespec_diff(const struct timespec* a, const struct timespec* b){
+	return (int64_t)(a->tv_sec - b->tv_sec) * 1000000000LL + (a->tv_nsec - b->tv_nsec);
+}
+
+static void step_sleep_until(const struct timespec* deadline){
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR){
+	}
+}
+
+// play one schedule: raise the entry's pins at its deadline, drop them a
+// pulse width later
+static void step_generator_play(STEP_GENERATOR* generator, STEP_MOVE* move){
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	step_timespec_add(&start, STEP_START_LEAD_NS);
+
+	GPIO* raised[3];
+	for(size_t i = 0; i < move->events.size(); i++){
+		const STEP_EVENT& event = move->events[i];
+		uint64_t pulse_ns = STEP_PULSE_NS;
+		if(i + 1 < move->events.size() && move->events[i + 1].time_ns - event.time_ns < 2 * pulse_ns){
+			pulse_ns = (move->events[i + 1].time_ns - event.time_ns) / 2;
+		}
+
+		int count = 0;
+		for(int pin = 0; pin < 3; pin++){
+			if((event.pins & (1 << pin)) && generator->pins[pin] != NULL){
+				raised[count++] = generator->pins[pin];
+			}
+		}
+
+		struct timespec deadline = start;
+		step_timespec_add(&deadline, event.time_ns);
+		step_sleep_until(&deadline);
+		gpio_backend_write_many(raised, count, GPIO::HIGH);
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		int64_t late_ns = step_timespec_diff(&now, &deadline);
+		move->jitter.steps++;
+		move->jitter.sum_ns += late_ns;
+		move->jitter.sum_sq_ns += (double)late_ns * late_ns;
+		if(late_ns > move->jitter.max_ns){
+			move->jitter.max_ns = late_ns;
+		}
+
+		step_timespec_add(&deadline, pulse_ns);
+		step_sleep_until(&deadline);
+		gpio_backend_write_many(raised, count, GPIO::LOW);
+	}
+}
+
+static void* step_generator_thread(void* arg){
+	STEP_GENERATOR* generator = (STEP_GENERATOR*)arg;
+	pthread_mutex_lock(&generator->lock);
+	while(1){
+		while(generator->pending == NULL){
+			pthread_cond_wait(&generator->wake, &generator->lock);
+		}
+		STEP_MOVE* move = generator->pending;
+		pthread_mutex_unlock(&generator->lock);
+
+		step_generator_play(generator, move);
+
+		pthread_mutex_lock(&generator->lock);
+		generator->pending = NULL;
+		pthread_cond_broadcast(&generator->wake);
+	}
+	return NULL;
+}
+
+// start the motion thread driving the given step and trigger pins (any may be
+// NULL). Returns -1 only if no thread could be started at all
+int step_generator_start(STEP_GENERATOR* generator, GPIO* pul_x, GPIO* pul_y, GPIO* trigger_pin, bool realtime){
+	generator->pins[0] = pul_x;
+	generator->pins[1] = pul_y;
+	generator->pins[2] = trigger_pin;
+	generator->pending = NULL;
+	generator->realtime = false;
+	pthread_mutex_init(&generator->lock, NULL);
+	pthread_cond_init(&generator->wake, NULL);
+
+	if(realtime){
+		// stack and schedules are faulted in now rather than mid-move
+		if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0){
+			perror("step generator: mlockall");
+		}
+
+		pthread_attr_t attr;
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = STEP_RT_PRIORITY;
+		pthread_attr_init(&attr);
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		pthread_attr_setschedparam(&attr, &param);
+		int error = pthread_create(&generator->thread, &attr, step_generator_thread, generator);
+		pthread_attr_destroy(&attr);
+		if(error == 0){
+			generator->realtime = true;
+			return 0;
+		}
+		printf("step generator: no SCHED_FIFO (%s), running at normal priority\n", strerror(error));
+	}
+
+	if(pthread_create(&generator->thread, NULL, step_generator_thread, generator) != 0){
+		perror("step generator: pthread_create");
+		return -1;
+	}
+	return 0;
+}
+
+// play move on the motion thread and wait for its last pulse
+void step_generator_run(STEP_GENERATOR* generator, STEP_MOVE* move){
+	memset(&move->jitter, 0, sizeof(move->jitter));
+	if(move->events.empty()){
+		return;
+	}
+	pthread_mutex_lock(&generator->lock);
+	generator->pending = move;
+	pthread_cond_broadcast(&generator->wake);
+	while(generator->pending != NULL){
+		pthread_cond_wait(&generator->wake, &generator->lock);
+	}
+	pthread_mutex_unlock(&generator->lock);
+}
+
+void step_jitter_print(const char* name, const STEP_JITTER* jitter){
+	if(jitter->steps == 0){
+		return;
+	}
+	double mean = jitter->sum_ns / jitter->steps;
+	double variance = jitter->sum_sq_ns / jitter->steps - mean * mean;
+	printf("%s: %u steps, edge lateness mean %.1f us, sd %.1f us, max %.1f us\n", name, jitter->steps,
+		mean / 1000.0, sqrt(variance > 0 ? variance : 0) / 1000.0, jitter->max_ns / 1000.0);
+}
+
+#endif /* STEP_GENERATOR_H_ */
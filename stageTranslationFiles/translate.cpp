@@ -8,10 +8,27 @@
 #include <signal.h>
 // include unistd to have access to linux functions such as usleep
 #include <unistd.h>
-// include Exploring BeagleBone GPIO library
+// include Exploring BeagleBone GPIO library, or the simulated one for
+// running without the stage (g++ -DSIM_GPIO)
+#ifdef SIM_GPIO
+#include "simGPIO.h"
+#else
 #include "gpio/GPIO.h"
+#endif
+// include gpio_backend.h for memory-mapped or character-device pin writes
+#include "gpio_backend.h"
 // include utiltiies.h
 #include "utilities.h"
+// include trigger.h for the camera trigger line
+#include "trigger.h"
+// include camera_client.h to drive a running camera daemon
+#include "camera_client.h"
+// include step_generator.h for the motion thread playing step schedules
+#include "step_generator.h"
+// include motion_profile.h for ramped step timing
+#include "motion_profile.h"
+// include stage_command.h for the command socket and command file watch
+#include "stage_command.h"
 //include ctime library 
 #include <time.h>
 // include stringstream library
@@ -21,15 +38,21 @@
 
 #define BILLION 1000000000.0
 
-static GPIO optoY(48);
-static GPIO pulY(49);
-static GPIO dirY(115);
-static GPIO enaY(112);
+static FastGPIO optoY(48);
+static FastGPIO pulY(49);
+static FastGPIO dirY(115);
+static FastGPIO enaY(112);
 
-static GPIO optoX(66);
-static GPIO pulX(69);
-static GPIO dirX(45);
-static GPIO enaX(47);
+static FastGPIO optoX(66);
+static FastGPIO pulX(69);
+static FastGPIO dirX(45);
+static FastGPIO enaX(47);
+
+static FastGPIO trig(TRIGGER_PIN);
+
+// every pin the stage drives, handed to the GPIO backend in one go
+static GPIO* stage_pins[] = {&optoY, &pulY, &dirY, &enaY, &optoX, &pulX, &dirX, &enaX, &trig};
+#define NUM_STAGE_PINS (int)(sizeof(stage_pins) / sizeof(stage_pins[0]))
 
 // implement signal handler
 void sig_handler(int signo)
@@ -40,16 +63,7 @@ void sig_handler(int signo)
     // turn motors off 
 
 	
-	optoX.setValue(GPIO::LOW);
-	pulX.setValue(GPIO::LOW);
-	dirX.setValue(GPIO::LOW);
-	enaX.setValue(GPIO::LOW);
-	
-	optoY.setValue(GPIO::LOW);
-	pulY.setValue(GPIO::LOW);
-	dirY.setValue(GPIO::LOW);
-	enaY.setValue(GPIO::LOW);
-	
+	gpio_backend_write_many(stage_pins, NUM_STAGE_PINS, GPIO::LOW);
 	
     
     // sleep for a second to allow actions to take effect
@@ -85,7 +99,8 @@ int main(int argc, char *argv[])
 	
 	const uint32_t PUL_SLEEP = 2000;
 	const uint32_t SIGNAL_SLEEP = 10;
-	const uint32_t STATE_SLEEP = 500;
+	// longest wait for a command while READY or IDLE before reporting again
+	const int COMMAND_WAIT_MS = 500;
 	const uint32_t FILE_SLEEP = 150000;
 	
 	const int MOD_NUM = 100;
@@ -98,9 +113,18 @@ int main(int argc, char *argv[])
 	MOTOR_TURN motor_state = READY;
 	MOTOR_TURN next_x_motor_state = IDLE;
 	
-	char camBashCommand [50];
+	// room for the longest capture name the command channel accepts
+	char camBashCommand [64 + STAGE_NAME_MAX];
 	string imgFileName;
 	
+	// true while a capture started through the camera daemon is running
+	bool camera_running = false;
+	int camera_result;
+	
+	TRIGGER_STATE trigger;
+	trigger.every_steps = 0;
+	trigger.count = 0;
+	
 	GPIO e_stop(65);
 	e_stop.setDirection(GPIO::INPUT);
 	
@@ -117,29 +141,34 @@ int main(int argc, char *argv[])
 	dirY.setDirection(GPIO::OUTPUT);
 	enaY.setDirection(GPIO::OUTPUT);
 	
+	trig.setDirection(GPIO::OUTPUT);
+	trig.setValue(GPIO::LOW);
+	
 	double difference;
 	struct timespec start, end;
 	int com = -1;
 	int size = -1;
 	
+	// mmap on the BeagleBone unless told otherwise; falls back to sysfs
+	GPIO_BACKEND_TYPE gpio_type = GPIO_BACKEND_MMAP;
+	
+	// step pulses come from the motion thread; the default rate matches the
+	// old PUL_SLEEP high + PUL_SLEEP low loops, unramped
+	STEP_GENERATOR stepper;
+	STEP_MOVE move;
+	bool realtime = true;
+	uint32_t step_hz = 1000000 / (2 * PUL_SLEEP);
+	MOTION_LIMITS limits;
+	limits.type = PROFILE_CONSTANT;
+	limits.max_acceleration = 2000;
+	limits.jerk = 20000;
+	
 	
 	
-	fstream sizeInFile;
-	fstream commandInFile;
 	fstream timeInfo;
 	fstream positionFile;
-	fstream fileNameFile;
 	ifstream readpos;
 	
-	commandInFile.open("./command_file.txt");
-	usleep(FILE_SLEEP); 
-    commandInFile << com;
-    commandInFile.close();
-     
-    sizeInFile.open("./size_file.txt");
-	usleep(FILE_SLEEP); 
-    sizeInFile << size;
-    sizeInFile.close();
     
     positionFile.open("./position_file.txt");
 	usleep(FILE_SLEEP); 
@@ -156,9 +185,11 @@ int main(int argc, char *argv[])
     string posFileName = "position_file.txt";
 	
     // evaluate command line arguments
-    // if there are not exactly 2 arguments in the argument count
-    // print an error and return to exit the program
-	if(argc != 2)
+    // "translate on|off [trigger steps] [--gpio=sysfs|mmap|gpiod] [--step-hz=N] [--rt=on|off]
+    //   [--profile=constant|trapezoid|scurve] [--accel=steps/s^2] [--jerk=steps/s^3]"
+    // if the state argument is missing print an error and return to exit the program
+    // the optional number triggers the camera every N X steps
+	if(argc < 2)
 	{
 		printf("Error: Incorrect number of arguments\n");
 		return 0;
@@ -185,7 +216,95 @@ int main(int argc, char *argv[])
 		    cout << "Error: Bad initialization state given, terminating" << endl;
 		    exit(0);
 		}
+		
+		for(int i = 2; i < argc; i++)
+		{
+			if(!strncmp(argv[i], "--gpio=", 7))
+			{
+				if(gpio_backend_parse(argv[i] + 7, &gpio_type) != 0)
+				{
+					cout << "Error: --gpio must be sysfs, mmap or gpiod" << endl;
+					return 0;
+				}
+			}
+			else if(!strncmp(argv[i], "--step-hz=", 10))
+			{
+				step_hz = atoi(argv[i] + 10);
+				if(step_hz == 0)
+				{
+					cout << "Error: --step-hz needs a positive step rate" << endl;
+					return 0;
+				}
+			}
+			else if(!strncmp(argv[i], "--profile=", 10))
+			{
+				if(motion_profile_parse(argv[i] + 10, &limits.type) != 0)
+				{
+					cout << "Error: --profile must be constant, trapezoid or scurve" << endl;
+					return 0;
+				}
+			}
+			else if(!strncmp(argv[i], "--accel=", 8))
+			{
+				limits.max_acceleration = atof(argv[i] + 8);
+				if(limits.max_acceleration <= 0)
+				{
+					cout << "Error: --accel needs a positive acceleration in steps/s^2" << endl;
+					return 0;
+				}
+			}
+			else if(!strncmp(argv[i], "--jerk=", 7))
+			{
+				limits.jerk = atof(argv[i] + 7);
+				if(limits.jerk <= 0)
+				{
+					cout << "Error: --jerk needs a positive jerk in steps/s^3" << endl;
+					return 0;
+				}
+			}
+			else if(!strcmp(argv[i], "--rt=on") || !strcmp(argv[i], "--rt=off"))
+			{
+				realtime = !strcmp(argv[i], "--rt=on");
+			}
+			else if(argv[i][0] != '-' && trigger.every_steps == 0)
+			{
+				trigger.every_steps = atoi(argv[i]);
+				printf("*** Camera trigger every %u X steps ****\n", trigger.every_steps);
+			}
+			else
+			{
+				printf("Error: Unknown argument %s\n", argv[i]);
+				return 0;
+			}
+		}
+	}
+	
+	// pin directions are set, move the writes off sysfs
+	if(gpio_backend_open(gpio_type) != 0 || gpio_backend_attach(stage_pins, NUM_STAGE_PINS) != 0)
+	{
+		cout << "GPIO backend " << gpio_backend_name(gpio_type) << " unavailable, using sysfs" << endl;
+		gpio_backend_close();
+	}
+	printf("*** GPIO writes through %s ****\n", gpio_backend_name(gpio_backend.type));
+	
+	if(step_generator_start(&stepper, &pulX, &pulY, &trig, realtime) != 0)
+	{
+		cout << "Error: could not start the motion thread" << endl;
+		return 0;
 	}
+	limits.max_velocity = step_hz;
+	printf("*** Steps at up to %u Hz, %s profile, on a %s motion thread ****\n", step_hz,
+		motion_profile_name(limits.type), stepper.realtime ? "SCHED_FIFO" : "normal priority");
+	
+	// START, STOP, REWIND and the slide size arrive on the command socket or
+	// through the old files, and wake the state machine as they arrive
+	STAGE_CHANNEL channel;
+	if(stage_channel_open(&channel, STAGE_SOCKET_PATH) != 0)
+	{
+		cout << "Error: neither the command socket nor the command file watch is available" << endl;
+		return 0;
+	}
+	printf("*** Commands on %s or command_file.txt ****\n", STAGE_SOCKET_PATH);
 	
 	
 	
@@ -222,11 +341,10 @@ int main(int argc, char *argv[])
 				enaY.setValue(GPIO::LOW);
 				usleep(SIGNAL_SLEEP);
 				
-				sizeInFile.open("./size_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    sizeInFile >> size;
-	    	    sizeInFile.close();
-	    	    
+				// block until a command arrives, waking to report now and then
+				stage_channel_wait(&channel, COMMAND_WAIT_MS);
+				size = channel.size;
+				
 	    	    if(size != -1){
 	    	    	if(size == 1){
 	    	    		NUM_ROWS = 10;
@@ -240,30 +358,39 @@ int main(int argc, char *argv[])
 	    	    }
 				
 				cout << "IN READY" << endl;
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP);
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				com = channel.command;
 	    	   
 				
 				if (com == 0){
-					fileNameFile.open("./file_name.txt");
-					usleep(FILE_SLEEP);
-					fileNameFile >> imgFileName;
-					fileNameFile.close();
+					imgFileName = channel.file_name;
 					
-					sprintf(camBashCommand, "./run_camera.sh %i %s &", size, imgFileName.c_str());
-					system(camBashCommand);
+					trigger_begin(&trigger, &trig);
+					
+					// a running camera daemon replies once it is streaming, so
+					// the first move lines up with the start of capture; with no
+					// daemon launch a one-shot camrunner as before. A daemon that
+					// refused still holds the camera, so don't scan at all
+					camera_result = camera_start(size, imgFileName.c_str());
+					if(camera_result == CAMERA_OK){
+						camera_running = true;
+						motor_state = POSITIVE_X;
+					}
+					else if(camera_result == CAMERA_NOT_RUNNING){
+						snprintf(camBashCommand, sizeof(camBashCommand), "./run_camera.sh %i %s &", size, imgFileName.c_str());
+						system(camBashCommand);
+						motor_state = POSITIVE_X;
+					}
+					else{
+						cout << "Camera daemon did not start the capture, scan skipped" << endl;
+						motor_state = IDLE;
+					}
 					
-					motor_state = POSITIVE_X;
 					positionFile.flush();
 					
 					clock_gettime(CLOCK_MONOTONIC, &start);
 					timeInfo.open("./timing.txt");
-					usleep(FILE_SLEEP); 
 				} 
 				
-				usleep(STATE_SLEEP);
 				
 			break;
 			
@@ -277,10 +404,16 @@ int main(int argc, char *argv[])
 				usleep(SIGNAL_SLEEP);
 				
 				cout << "IN IDLE" << endl;
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				
+				// scan finished or stopped, end the daemon's capture with it
+				if(camera_running){
+					camera_stop();
+					camera_running = false;
+				}
+				
+				// block until a command arrives, waking to report now and then
+				stage_channel_wait(&channel, COMMAND_WAIT_MS);
+				com = channel.command;
 	    	    
 	    	    cout << x_position << endl;
 	    	    cout << y_position << endl;
@@ -290,7 +423,6 @@ int main(int argc, char *argv[])
 					motor_state = REWIND;
 				}
 				
-				usleep(STATE_SLEEP);
 			break;
 			
 			case POSITIVE_X:
@@ -305,10 +437,8 @@ int main(int argc, char *argv[])
 				dirX.setValue(GPIO::LOW);
 				usleep(SIGNAL_SLEEP);
 				
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				stage_channel_wait(&channel, 0);
+				com = channel.command;
 	    	    
 				clock_gettime(CLOCK_MONOTONIC, &end);		/* mark the end time */
 				difference = double(end.tv_sec - start.tv_sec)  + (double(end.tv_nsec - start.tv_nsec) / BILLION);
@@ -317,11 +447,21 @@ int main(int argc, char *argv[])
 				timeInfo << difference << endl; 
 				cout << difference << endl; 
 				
+				// the whole row is one schedule, with the trigger line raised
+				// together with every Nth step
+				step_move_profile(&move, &limits, MAX_X_POSITION - x_position, STEP_PIN_X);
+				for(uint32_t i = 0; i < move.events.size(); i++){
+					if(trigger_due(&trigger, x_position + i)){
+						move.events[i].pins |= STEP_PIN_TRIGGER;
+					}
+				}
+				step_generator_run(&stepper, &move);
+				step_jitter_print("POSITIVE_X", &move.jitter);
+				
 				while(x_position < MAX_X_POSITION){
-					pulX.setValue(GPIO::HIGH);
-					usleep(PUL_SLEEP);
-					pulX.setValue(GPIO::LOW);
-					usleep(PUL_SLEEP);
+					if(trigger_due(&trigger, x_position)){
+						trigger_record(&trigger, x_position, y_position);
+					}
 					x_position++;
 					
 					if((x_position % MOD_NUM) == 0){
@@ -336,10 +476,8 @@ int main(int argc, char *argv[])
 				timeInfo << difference << endl; 
 				cout << difference << endl; 
 				
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				stage_channel_wait(&channel, 0);
+				com = channel.command;
 	    	    
 				if((x_position == MAX_X_POSITION) && (num_comp_rows < NUM_ROWS)){
 					num_comp_rows++;
@@ -369,7 +507,6 @@ int main(int argc, char *argv[])
 				
 				enaX.setValue(GPIO::LOW);
 				
-				usleep(STATE_SLEEP);
 				
 			break;
 			
@@ -381,10 +518,8 @@ int main(int argc, char *argv[])
 				enaX.setValue(GPIO::HIGH);
 				usleep(SIGNAL_SLEEP);
 				
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				stage_channel_wait(&channel, 0);
+				com = channel.command;
 	    	    
 				dirX.setValue(GPIO::HIGH);
 				usleep(SIGNAL_SLEEP);
@@ -397,11 +532,19 @@ int main(int argc, char *argv[])
 				cout << difference << endl; 
 				
 				
+				step_move_profile(&move, &limits, x_position, STEP_PIN_X);
+				for(uint32_t i = 0; i < move.events.size(); i++){
+					if(trigger_due(&trigger, x_position - i)){
+						move.events[i].pins |= STEP_PIN_TRIGGER;
+					}
+				}
+				step_generator_run(&stepper, &move);
+				step_jitter_print("NEGATIVE_X", &move.jitter);
+				
 				while(x_position > 0){
-					pulX.setValue(GPIO::HIGH);
-					usleep(PUL_SLEEP);
-					pulX.setValue(GPIO::LOW);
-					usleep(PUL_SLEEP);
+					if(trigger_due(&trigger, x_position)){
+						trigger_record(&trigger, x_position, y_position);
+					}
 					
 					x_position--;
 					
@@ -430,7 +573,6 @@ int main(int argc, char *argv[])
 				
 				enaX.setValue(GPIO::LOW);
 				
-				usleep(STATE_SLEEP);
 				
 			break;
 			
@@ -445,10 +587,8 @@ int main(int argc, char *argv[])
 				dirY.setValue(GPIO::LOW);
 				usleep(SIGNAL_SLEEP);
 				
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				stage_channel_wait(&channel, 0);
+				com = channel.command;
 				
 			    clock_gettime(CLOCK_MONOTONIC, &end);		/* mark the end time */
 				difference = double(end.tv_sec - start.tv_sec)  + double((end.tv_nsec - start.tv_nsec) / BILLION);
@@ -457,12 +597,11 @@ int main(int argc, char *argv[])
 				timeInfo << difference << endl; 
 				cout << difference << endl; 
 				
-				for(int i = 0; i <  MAX_Y_POSITION; i++){
-					
-					pulY.setValue(GPIO::HIGH);
-				    usleep(PUL_SLEEP);
-					pulY.setValue(GPIO::LOW);
-					usleep(PUL_SLEEP);
+				step_move_profile(&move, &limits, MAX_Y_POSITION, STEP_PIN_Y);
+				step_generator_run(&stepper, &move);
+				step_jitter_print("POSITIVE_Y", &move.jitter);
+				
+				for(uint32_t i = 0; i <  MAX_Y_POSITION; i++){
 					
 					y_position++;
 					
@@ -471,10 +610,8 @@ int main(int argc, char *argv[])
 					}
 				}	
 				
-				commandInFile.open("./command_file.txt");
-		        usleep(FILE_SLEEP); 
-	    	    commandInFile >> com;
-	    	    commandInFile.close();
+				stage_channel_wait(&channel, 0);
+				com = channel.command;
 				
 				clock_gettime(CLOCK_MONOTONIC, &end);		/* mark the end time */
 				difference = double(end.tv_sec - start.tv_sec)  + double((end.tv_nsec - start.tv_nsec) / BILLION);
@@ -496,7 +633,6 @@ int main(int argc, char *argv[])
 				
 				enaY.setValue(GPIO::LOW);
 				
-				usleep(STATE_SLEEP);
 			break;
 			
 			case NEGATIVE_Y:
@@ -508,15 +644,12 @@ int main(int argc, char *argv[])
 				dirY.setValue(GPIO::HIGH);
 				usleep(SIGNAL_SLEEP);
 				
-				pulY.setValue(GPIO::HIGH);
-			    usleep(PUL_SLEEP);
-				pulY.setValue(GPIO::LOW);
-				usleep(PUL_SLEEP);
+				step_move_profile(&move, &limits, 1, STEP_PIN_Y);
+				step_generator_run(&stepper, &move);
 				
 				
 				y_position--;
 				
-				usleep(STATE_SLEEP);
 				
 			break;
 			
@@ -526,41 +659,35 @@ int main(int argc, char *argv[])
 				
 				
 				
-				enaX.setValue(GPIO::LOW);
+				// both axes together, straight back to the origin from
+				// wherever the scan stopped
+				enaX.setValue(GPIO::HIGH);
 				enaY.setValue(GPIO::HIGH);
 				usleep(SIGNAL_SLEEP);
 				
+				dirX.setValue(GPIO::HIGH);
 				dirY.setValue(GPIO::HIGH);
-				
-				for(int i = 0; i < NUM_ROWS; i++){
-					for(int j = 0; j <  MAX_Y_POSITION; j++){
-					
-						pulY.setValue(GPIO::HIGH);
-					    usleep(PUL_SLEEP);
-						pulY.setValue(GPIO::LOW);
-						usleep(PUL_SLEEP);
-						if((y_position % MOD_NUM) == 0){
-							positionFile << x_position << " " << y_position << endl;
-						}
-					}
-					
-					usleep(FILE_SLEEP);
-					
-				}
-				
-				
-				enaY.setValue(GPIO::LOW);
-				enaX.setValue(GPIO::HIGH);
 				usleep(SIGNAL_SLEEP);
 				
-				dirX.setValue(GPIO::HIGH);
-				usleep(SIGNAL_SLEEP);
-				while(x_position >  0){
-					pulX.setValue(GPIO::HIGH);
-					usleep(PUL_SLEEP);
-					pulX.setValue(GPIO::LOW);
-					usleep(PUL_SLEEP);
-					x_position--;
+				step_move_line(&move, &limits, x_position, y_position);
+				step_generator_run(&stepper, &move);
+				step_jitter_print("REWIND", &move.jitter);
+				
+				for(uint32_t i = 0; i < move.events.size(); i++){
+					// log only when an axis stepped by this event lands on a
+					// multiple of MOD_NUM, not on every step of the other axis
+					bool crossed = false;
+					if(move.events[i].pins & STEP_PIN_X){
+						x_position--;
+						crossed = crossed || (x_position % MOD_NUM) == 0;
+					}
+					if(move.events[i].pins & STEP_PIN_Y){
+						y_position--;
+						crossed = crossed || (y_position % MOD_NUM) == 0;
+					}
+					if(crossed){
+						positionFile << x_position << " " << y_position << endl;
+					}
 				}
 				
 				
@@ -577,7 +704,6 @@ int main(int argc, char *argv[])
 				
 				motor_state = READY;
 				
-				usleep(STATE_SLEEP);
 				
 			
 				
@@ -0,0 +1,50 @@
+#ifndef TRIGGER_H_
+#define TRIGGER_H_
+
+#include <fstream>
+#include "common.h"
+
+// use the standard namespace
+using namespace std;
+using namespace exploringBB;
+
+// spare GPIO wired to the camera's trigger input (Line0), P9_12
+#define TRIGGER_PIN 60
+
+// keep track of the frames triggered during one scan
+typedef struct{
+	uint32_t every_steps;	// trigger every N X steps, 0 leaves the camera free-running
+	uint32_t count;		// triggers sent since the scan started
+	fstream log;		// trigger_file.txt: "<frame> <x> <y>" per trigger
+}TRIGGER_STATE;
+
+// function protoypes
+bool trigger_due(TRIGGER_STATE*, uint32_t);
+void trigger_begin(TRIGGER_STATE*, GPIO*);
+void trigger_record(TRIGGER_STATE*, uint32_t, uint32_t);
+
+// true when the step about to be taken at x_position should expose a frame
+bool trigger_due(TRIGGER_STATE* trigger, uint32_t x_position){
+	return trigger->every_steps > 0 && (x_position % trigger->every_steps) == 0;
+}
+
+// start a scan: trigger line low, frame numbering from zero and a fresh log
+void trigger_begin(TRIGGER_STATE* trigger, GPIO* trigger_pin){
+	trigger_pin->setValue(GPIO::LOW);
+	trigger->count = 0;
+	if(trigger->log.is_open()){
+		trigger->log.close();
+	}
+	trigger->log.open("./trigger_file.txt", fstream::out | fstream::trunc);
+}
+
+// the step generator raises the trigger line together with the X step pulse,
+// so the camera's rising edge lands on the step edge. Once the move is done,
+// each pulse is recorded with the (x, y) step count the frame belongs to;
+// frame N of the capture is line N of the log.
+void trigger_record(TRIGGER_STATE* trigger, uint32_t x_position, uint32_t y_position){
+	trigger->log << trigger->count << " " << x_position << " " << y_position << endl;
+	trigger->count++;
+}
+
+#endif /* TRIGGER_H_ */